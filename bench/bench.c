@@ -0,0 +1,371 @@
+// bench - benchmark of lookup engines
+//
+// Prints the size of the model tables, unigram lookups per second and throughput of hcbudoux_impl_getnext(), block
+// segmentation (each kernel which the host supports), hcbudoux_find_breaks(), hcbudoux_find_breaks_bitmap(),
+// hcbudoux_find_scores() and hcbudoux_find_breaks_thresholds() for each model.  It also prints n-gram lookups per
+// character of hcbudoux_impl_getnext() and block segmentation (all lookups).  Makefile builds this file with each
+// lookup engine (HCBUDOUX_LOOKUP_*), with HCBUDOUX_BRANCH_AND_BOUND and with AVX2.
+#define HCBUDOUX_IMPLEMENTATION 1
+#define HCBUDOUX_IMPL_COUNT_LOOKUP() (++ngramLookupCount)
+#include <stdbool.h>  // bool, true, false
+#include <stdint.h>   // uint32_t, uint64_t
+#include <stdio.h>    // printf
+#include <stdlib.h>   // malloc, free, qsort, EXIT_SUCCESS
+#include <string.h>   // memcpy, memset
+#include <time.h>     // timespec_get
+
+static long ngramLookupCount;
+
+#include "hcbudoux.h"
+
+enum {
+  textSizeInBytes = 1 << 20,
+  lookupCount = 1 << 16,
+};
+
+static double now(void) {
+  struct timespec ts;
+  timespec_get(&ts, TIME_UTC);
+  return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static uint32_t random32(uint64_t *state) {
+  *state = *state * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+  return (uint32_t)(*state >> 33);
+}
+
+static int compareU32(const void *a, const void *b) {
+  uint32_t const x = *(const uint32_t *)a;
+  uint32_t const y = *(const uint32_t *)b;
+  return (x > y) - (x < y);
+}
+
+// Sorted keys of the table.  Keys may be ordered by the lookup engine.
+static uint32_t *sortedKeys(const uint32_t *keys, int count) {
+  uint32_t *const sorted = (uint32_t *)malloc(sizeof(sorted[0]) * (size_t)count);
+  memcpy(sorted, keys, sizeof(sorted[0]) * (size_t)count);
+  qsort(sorted, (size_t)count, sizeof(sorted[0]), compareU32);
+  return sorted;
+}
+
+static int encodeUtf8(uint32_t c, char *p) {
+  if (c < 0x80) {
+    p[0] = (char)c;
+    return 1;
+  } else if (c < 0x800) {
+    p[0] = (char)(0xc0 | (c >> 6));
+    p[1] = (char)(0x80 | (c & 0x3f));
+    return 2;
+  } else if (c < 0x10000) {
+    p[0] = (char)(0xe0 | (c >> 12));
+    p[1] = (char)(0x80 | ((c >> 6) & 0x3f));
+    p[2] = (char)(0x80 | (c & 0x3f));
+    return 3;
+  }
+  p[0] = (char)(0xf0 | (c >> 18));
+  p[1] = (char)(0x80 | ((c >> 12) & 0x3f));
+  p[2] = (char)(0x80 | ((c >> 6) & 0x3f));
+  p[3] = (char)(0x80 | (c & 0x3f));
+  return 4;
+}
+
+// Generate pseudo text from the keys of the model and a few characters which are not in the model.
+// latinPercent is the percentage of Latin words (runs of ASCII letters) in the text.
+static int generateText(const hcbudoux_impl_tables *tables, int latinPercent, char *text, uint32_t *codepoints) {
+  // uw[id] is the character of the ID.  Keys of bw and tw are IDs in mixed radix.
+  uint32_t *const uw = sortedKeys(tables->uw.keys, tables->uw.count);
+  uint32_t *const bw = sortedKeys(tables->bw.keys, tables->bw.count);
+  uint32_t *const tw = sortedKeys(tables->tw.keys, tables->tw.count);
+  uint32_t const radix = (uint32_t)tables->uw.count;
+  uint64_t state = 1;
+  int size = 0;
+  int count = 0;
+  while (size + 16 <= textSizeInBytes) {
+    uint32_t cs[16];
+    int n = 0;
+    uint32_t const r = random32(&state) % 100;
+    if (random32(&state) % 100 < (uint32_t)latinPercent) {
+      int const length = 2 + (int)(random32(&state) % 12);
+      for (int i = 0; i < length; ++i) {
+        cs[n++] = 'a' + random32(&state) % 26;
+      }
+      cs[n++] = ' ';
+    } else if (r < 25) {
+      uint32_t const k = tw[random32(&state) % (uint32_t)tables->tw.count];
+      cs[n++] = uw[k / radix / radix];
+      cs[n++] = uw[k / radix % radix];
+      cs[n++] = uw[k % radix];
+    } else if (r < 50) {
+      uint32_t const k = bw[random32(&state) % (uint32_t)tables->bw.count];
+      cs[n++] = uw[k / radix];
+      cs[n++] = uw[k % radix];
+    } else if (r < 85) {
+      cs[n++] = uw[random32(&state) % radix];
+    } else {
+      cs[n++] = 0x3041 + random32(&state) % (0x9fff - 0x3041);
+    }
+    for (int i = 0; i < n; ++i) {
+      if (count < lookupCount) {
+        codepoints[count++] = cs[i];
+      }
+      size += encodeUtf8(cs[i], text + size);
+    }
+  }
+  free(tw);
+  free(bw);
+  free(uw);
+  return size;
+}
+
+static int tablesSizeInBytes(const hcbudoux_impl_tables *tables) {
+  int size = 0;
+  size += tables->uw.count * (int)sizeof(tables->uw.keys[0]);
+  size += tables->uw.ids ? tables->uw.count * (int)sizeof(tables->uw.ids[0]) : 0;
+  size += (tables->uw.count + 1) * (int)sizeof(tables->uw.items[0]);
+  size += (tables->uw.count + 1) * (int)sizeof(tables->uw.masks[0]);
+  size += tables->uw.disp_count * (int)sizeof(tables->uw.disp[0]);
+  size += tables->uw.page_index_count * (int)sizeof(tables->uw.page_index[0]);
+  size += tables->uw.page_count * 256 * (int)sizeof(tables->uw.pages[0]);
+  size += tables->bw.count * (int)sizeof(tables->bw.keys[0]);
+  size += (tables->bw.count + 1) * (int)sizeof(tables->bw.items[0]);
+  size += tables->bw.disp_count * (int)sizeof(tables->bw.disp[0]);
+  size += tables->tw.count * (int)sizeof(tables->tw.keys[0]);
+  size += (tables->tw.count + 1) * (int)sizeof(tables->tw.items[0]);
+  size += tables->tw.disp_count * (int)sizeof(tables->tw.disp[0]);
+  return size;
+}
+
+// Returns throughput of hcbudoux_impl_getnext() in bytes per second.
+static double benchGetnext(hcbudoux_impl_lang lang, const char *text, int textSize, long *spanCount) {
+  long n = 0;
+  double const t0 = now();
+  double t1 = t0;
+  while (t1 - t0 < 0.25) {
+    hcbudoux_ctx ctx;
+    hcbudoux_span span;
+    hcbudoux_init(&ctx, text, textSize);
+    *spanCount = 0;
+    while (hcbudoux_impl_getnext(&ctx, &span, lang)) {
+      ++*spanCount;
+    }
+    n += textSize;
+    t1 = now();
+  }
+  return (double)n / (t1 - t0);
+}
+
+// Returns throughput of hcbudoux_find_breaks() in bytes per second.
+static double benchFindBreaks(hcbudoux_impl_lang lang, const char *text, int textSize, int *offsets, long *breakCount) {
+  long n = 0;
+  double const t0 = now();
+  double t1 = t0;
+  while (t1 - t0 < 0.25) {
+    *breakCount = hcbudoux_find_breaks((hcbudoux_lang)lang, text, textSize, offsets, textSize);
+    n += textSize;
+    t1 = now();
+  }
+  return (double)n / (t1 - t0);
+}
+
+// Returns throughput of hcbudoux_find_scores() in bytes per second.
+static double benchFindScores(hcbudoux_impl_lang lang, const char *text, int textSize, int *scores) {
+  long n = 0;
+  double const t0 = now();
+  double t1 = t0;
+  while (t1 - t0 < 0.25) {
+    hcbudoux_find_scores((hcbudoux_lang)lang, text, textSize, scores, NULL, textSize);
+    n += textSize;
+    t1 = now();
+  }
+  return (double)n / (t1 - t0);
+}
+
+// Returns throughput of hcbudoux_find_breaks_bitmap(), or hcbudoux_impl_getnext() which sets the offsets of the spans
+// to the bitmap (spans), in bytes per second.
+static double benchBitmap(hcbudoux_impl_lang lang, const char *text, int textSize, uint64_t *bitmap, bool spans) {
+  long n = 0;
+  double const t0 = now();
+  double t1 = t0;
+  while (t1 - t0 < 0.25) {
+    memset(bitmap, 0, sizeof(bitmap[0]) * (size_t)(textSize / 64 + 1));
+    if (spans) {
+      hcbudoux_ctx ctx;
+      hcbudoux_span span;
+      hcbudoux_init(&ctx, text, textSize);
+      while (hcbudoux_impl_getnext(&ctx, &span, lang)) {
+        if (span.offset > 0) {
+          bitmap[span.offset / 64] |= (uint64_t)1 << (span.offset % 64);
+        }
+      }
+    } else {
+      hcbudoux_find_breaks_bitmap((hcbudoux_lang)lang, text, textSize, bitmap);
+    }
+    n += textSize;
+    t1 = now();
+  }
+  return (double)n / (t1 - t0);
+}
+
+// Returns throughput of hcbudoux_find_breaks_thresholds() with 3 thresholds, or hcbudoux_find_breaks_bitmap() for each
+// threshold (passes), in bytes per second.  bitmap has 3 bitmaps.
+static double benchThresholds(hcbudoux_impl_lang lang, const char *text, int textSize, uint64_t *bitmap, bool passes) {
+  static const int thresholds[] = {0, -1000, 1000};
+  int const words = textSize / 64 + 1;
+  uint64_t *const bitmaps[] = {bitmap, bitmap + words, bitmap + words * 2};
+  long n = 0;
+  double const t0 = now();
+  double t1 = t0;
+  while (t1 - t0 < 0.25) {
+    memset(bitmap, 0, sizeof(bitmap[0]) * (size_t)words * 3);
+    if (passes) {
+      // Without the thresholds, each granularity runs the segmentation again.
+      for (int k = 0; k < 3; ++k) {
+        hcbudoux_find_breaks_bitmap((hcbudoux_lang)lang, text, textSize, bitmaps[k]);
+      }
+    } else {
+      hcbudoux_find_breaks_thresholds((hcbudoux_lang)lang, text, textSize, thresholds, 3, bitmaps);
+    }
+    n += textSize;
+    t1 = now();
+  }
+  return (double)n / (t1 - t0);
+}
+
+// Returns throughput of block segmentation with the kernel in bytes per second, or 0 if the host doesn't support it.
+static double benchBlock(hcbudoux_impl_lang lang, const char *text, int textSize, hcbudoux_impl_kernel kernel,
+                         long *boundaryCount) {
+  long n = 0;
+  if (!hcbudoux_impl_set_kernel(kernel)) {
+    return 0.0;
+  }
+  double const t0 = now();
+  double t1 = t0;
+  while (t1 - t0 < 0.25) {
+    hcbudoux_impl_block block;
+    hcbudoux_impl_init_block(&block, hcbudoux_impl_get_tables(lang), text, textSize);
+    *boundaryCount = 0;
+    while (hcbudoux_impl_fill_block(&block)) {
+      for (uint64_t bits = hcbudoux_impl_score_block(&block); bits; bits &= bits - 1) {
+        ++*boundaryCount;
+      }
+    }
+    n += textSize;
+    t1 = now();
+  }
+  hcbudoux_impl_set_kernel(hcbudoux_impl_kernel_auto);
+  return (double)n / (t1 - t0);
+}
+
+// Counts n-gram lookups per character of hcbudoux_impl_getnext() and block segmentation.
+static void countLookups(hcbudoux_impl_lang lang, const char *text, int textSize, double *getnextLookups,
+                         double *blockLookups) {
+  long charCount = 0;
+  {
+    hcbudoux_impl_block block;
+    hcbudoux_impl_init_block(&block, hcbudoux_impl_get_tables(lang), text, textSize);
+    ngramLookupCount = 0;
+    while (hcbudoux_impl_fill_block(&block)) {
+      charCount += block.count;
+    }
+    *blockLookups = (double)ngramLookupCount / (double)charCount;
+  }
+  {
+    hcbudoux_ctx ctx;
+    hcbudoux_span span;
+    hcbudoux_init(&ctx, text, textSize);
+    ngramLookupCount = 0;
+    while (hcbudoux_impl_getnext(&ctx, &span, lang)) {
+    }
+    *getnextLookups = (double)ngramLookupCount / (double)charCount;
+  }
+}
+
+static void bench(const char *name, hcbudoux_impl_lang lang, char *text, uint32_t *codepoints, int *offsets,
+                  uint64_t *bitmap) {
+  const hcbudoux_impl_tables *const tables = hcbudoux_impl_get_tables(lang);
+  int textSize = generateText(tables, 0, text, codepoints);
+  double lookupsPerSec = 0.0;
+  double bytesPerSec = 0.0;
+  double mixedBytesPerSec = 0.0;
+  double blockBytesPerSec[3] = {0.0, 0.0, 0.0};  // scalar, AVX2, AVX-512
+  double findBreaksBytesPerSec = 0.0;
+  double bitmapBytesPerSec = 0.0;
+  double findScoresBytesPerSec = 0.0;
+  double thresholdsBytesPerSec = 0.0;
+  double passesBytesPerSec = 0.0;
+  double spansBitmapBytesPerSec = 0.0;
+  double getnextLookups = 0.0;
+  double blockLookups = 0.0;
+  long spanCount = 0;
+  long mixedSpanCount = 0;
+  long boundaryCount = 0;
+  long breakCount = 0;
+  volatile long sink = 0;
+
+  {
+    long n = 0;
+    double const t0 = now();
+    double t1 = t0;
+    while (t1 - t0 < 0.25) {
+      long sum = 0;
+      for (int i = 0; i < lookupCount; ++i) {
+        sum += hcbudoux_impl_find_unigram(&tables->uw, codepoints[i]);
+      }
+      sink = sum;
+      n += lookupCount;
+      t1 = now();
+    }
+    lookupsPerSec = (double)n / (t1 - t0);
+  }
+
+  bytesPerSec = benchGetnext(lang, text, textSize, &spanCount);
+  blockBytesPerSec[0] = benchBlock(lang, text, textSize, hcbudoux_impl_kernel_scalar, &boundaryCount);
+  blockBytesPerSec[1] = benchBlock(lang, text, textSize, hcbudoux_impl_kernel_avx2, &boundaryCount);
+  blockBytesPerSec[2] = benchBlock(lang, text, textSize, hcbudoux_impl_kernel_avx512, &boundaryCount);
+  findBreaksBytesPerSec = benchFindBreaks(lang, text, textSize, offsets, &breakCount);
+  bitmapBytesPerSec = benchBitmap(lang, text, textSize, bitmap, false);
+  spansBitmapBytesPerSec = benchBitmap(lang, text, textSize, bitmap, true);
+  findScoresBytesPerSec = benchFindScores(lang, text, textSize, offsets);
+  thresholdsBytesPerSec = benchThresholds(lang, text, textSize, bitmap, false);
+  passesBytesPerSec = benchThresholds(lang, text, textSize, bitmap, true);
+  countLookups(lang, text, textSize, &getnextLookups, &blockLookups);
+
+  // Mixed Latin and CJK (or Thai) text.
+  textSize = generateText(tables, 50, text, codepoints);
+  mixedBytesPerSec = benchGetnext(lang, text, textSize, &mixedSpanCount);
+
+  (void)sink;
+  printf("%-8s: tables %7d bytes, unigram lookup %6.1f M/s, getnext %6.1f MB/s, mixed %6.1f MB/s, %ld spans\n", name,
+         tablesSizeInBytes(tables), lookupsPerSec * 1e-6, bytesPerSec * 1e-6, mixedBytesPerSec * 1e-6, spanCount);
+  printf("%-8s  block scalar %6.1f, avx2 %6.1f, avx512 %6.1f MB/s, %ld boundaries\n", "", blockBytesPerSec[0] * 1e-6,
+         blockBytesPerSec[1] * 1e-6, blockBytesPerSec[2] * 1e-6, boundaryCount);
+  printf("%-8s  find_breaks %6.1f MB/s, %ld breaks, bitmap %6.1f MB/s (getnext and bits %6.1f MB/s)\n", "",
+         findBreaksBytesPerSec * 1e-6, breakCount, bitmapBytesPerSec * 1e-6, spansBitmapBytesPerSec * 1e-6);
+  printf("%-8s  find_scores %6.1f MB/s, 3 thresholds %6.1f MB/s (3 passes %6.1f MB/s)\n", "",
+         findScoresBytesPerSec * 1e-6, thresholdsBytesPerSec * 1e-6, passesBytesPerSec * 1e-6);
+  printf("%-8s  n-gram lookups per character : getnext %.3f, block %.3f\n", "", getnextLookups, blockLookups);
+}
+
+int main(int argc, const char **argv) {
+  char *const text = (char *)malloc(textSizeInBytes);
+  uint32_t *const codepoints = (uint32_t *)malloc(sizeof(codepoints[0]) * lookupCount);
+  int *const offsets = (int *)malloc(sizeof(offsets[0]) * textSizeInBytes);
+  uint64_t *const bitmap = (uint64_t *)malloc(sizeof(bitmap[0]) * (textSizeInBytes / 64 + 1) * 3);
+  (void)argc;
+  (void)argv;
+
+  printf("%s: perfect_hash=%d, eytzinger=%d, unigram_page_table=%d, switch=%d, branch_and_bound=%d, avx2=%d\n", argv[0],
+         HCBUDOUX_IMPL_PERFECT_HASH, HCBUDOUX_IMPL_EYTZINGER, HCBUDOUX_IMPL_UNIGRAM_PAGE_TABLE, HCBUDOUX_IMPL_SWITCH,
+         HCBUDOUX_IMPL_BRANCH_AND_BOUND, HCBUDOUX_IMPL_AVX2);
+  bench("ja", hcbudoux_impl_lang_ja, text, codepoints, offsets, bitmap);
+  bench("ja_knbc", hcbudoux_impl_lang_ja_knbc, text, codepoints, offsets, bitmap);
+  bench("th", hcbudoux_impl_lang_th, text, codepoints, offsets, bitmap);
+  bench("zh_hans", hcbudoux_impl_lang_zh_hans, text, codepoints, offsets, bitmap);
+  bench("zh_hant", hcbudoux_impl_lang_zh_hant, text, codepoints, offsets, bitmap);
+
+  free(bitmap);
+  free(offsets);
+  free(codepoints);
+  free(text);
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,45 @@
+@echo off && setlocal EnableDelayedExpansion && cd /d "%~dp0" && call "%~dp0..\script\intro.bat"
+
+set "Options=/std:c11 /O2 /I ..\include"
+
+echo %MSVC% %Options% /Fe:bench-sorted.exe bench.c
+call %MSVC% %Options% /Fe:bench-sorted.exe bench.c || goto :ERROR
+                    .\bench-sorted.exe             || goto :ERROR
+
+echo %MSVC% %Options% /DHCBUDOUX_LOOKUP_PERFECT_HASH=1 /Fe:bench-perfect-hash.exe bench.c
+call %MSVC% %Options% /DHCBUDOUX_LOOKUP_PERFECT_HASH=1 /Fe:bench-perfect-hash.exe bench.c || goto :ERROR
+                    .\bench-perfect-hash.exe                                              || goto :ERROR
+
+echo %MSVC% %Options% /DHCBUDOUX_LOOKUP_EYTZINGER=1 /Fe:bench-eytzinger.exe bench.c
+call %MSVC% %Options% /DHCBUDOUX_LOOKUP_EYTZINGER=1 /Fe:bench-eytzinger.exe bench.c || goto :ERROR
+                    .\bench-eytzinger.exe                                         || goto :ERROR
+
+echo %MSVC% %Options% /DHCBUDOUX_LOOKUP_UNIGRAM_PAGE_TABLE=1 /Fe:bench-unigram-page-table.exe bench.c
+call %MSVC% %Options% /DHCBUDOUX_LOOKUP_UNIGRAM_PAGE_TABLE=1 /Fe:bench-unigram-page-table.exe bench.c || goto :ERROR
+                    .\bench-unigram-page-table.exe                                                    || goto :ERROR
+
+echo %MSVC% %Options% /DHCBUDOUX_LOOKUP_SWITCH=1 /Fe:bench-switch.exe bench.c
+call %MSVC% %Options% /DHCBUDOUX_LOOKUP_SWITCH=1 /Fe:bench-switch.exe bench.c || goto :ERROR
+                    .\bench-switch.exe                                      || goto :ERROR
+
+echo %MSVC% %Options% /DHCBUDOUX_BRANCH_AND_BOUND=1 /Fe:bench-sorted-branch-and-bound.exe bench.c
+call %MSVC% %Options% /DHCBUDOUX_BRANCH_AND_BOUND=1 /Fe:bench-sorted-branch-and-bound.exe bench.c || goto :ERROR
+                    .\bench-sorted-branch-and-bound.exe                                          || goto :ERROR
+
+echo %MSVC% %Options% /DHCBUDOUX_LOOKUP_PERFECT_HASH=1 /DHCBUDOUX_BRANCH_AND_BOUND=1 /Fe:bench-perfect-hash-branch-and-bound.exe bench.c
+call %MSVC% %Options% /DHCBUDOUX_LOOKUP_PERFECT_HASH=1 /DHCBUDOUX_BRANCH_AND_BOUND=1 /Fe:bench-perfect-hash-branch-and-bound.exe bench.c || goto :ERROR
+                    .\bench-perfect-hash-branch-and-bound.exe                                                                         || goto :ERROR
+
+echo %MSVC% %Options% /arch:AVX2 /Fe:bench-sorted-avx2.exe bench.c
+call %MSVC% %Options% /arch:AVX2 /Fe:bench-sorted-avx2.exe bench.c || goto :ERROR
+                    .\bench-sorted-avx2.exe                        || goto :ERROR
+
+echo %MSVC% %Options% /arch:AVX2 /DHCBUDOUX_LOOKUP_PERFECT_HASH=1 /Fe:bench-perfect-hash-avx2.exe bench.c
+call %MSVC% %Options% /arch:AVX2 /DHCBUDOUX_LOOKUP_PERFECT_HASH=1 /Fe:bench-perfect-hash-avx2.exe bench.c || goto :ERROR
+                    .\bench-perfect-hash-avx2.exe                                                      || goto :ERROR
+
+:OK
+%Exit_OK%
+
+:ERROR
+%Exit_NG%
@@ -3,6 +3,8 @@
 #endif
 #include <json.h>  // https://github.com/sheredom/json.h/blob/master/json.h
 
+#include <algorithm>
+#include <cstdint>
 #include <map>
 #include <string>
 #include <vector>
@@ -149,6 +151,99 @@ Model loadModel(const std::string &json) {
   return model;
 }
 
+namespace PerfectHash {
+// Hash-and-displace minimal perfect hash.
+// These functions must be identical to hcbudoux_impl_phash_*() in hcbudoux.template.h.
+uint32_t fastRange(uint64_t h, size_t n) { return static_cast<uint32_t>(((h >> 32) * n) >> 32); }
+
+uint32_t bucket(uint64_t key, size_t dispCount) { return fastRange(key * UINT64_C(0x9e3779b97f4a7c15), dispCount); }
+
+uint32_t slot(uint64_t key, uint16_t disp, size_t count) {
+  uint64_t const h = key * UINT64_C(0x9e3779b97f4a7c15);
+  return fastRange((h ^ disp) * UINT64_C(0xc2b2ae3d27d4eb4f), count);
+}
+
+struct Table {
+  std::vector<uint16_t> displacements;  // [bucket] = displacement
+  std::vector<size_t> order;            // [slot] = index of keys
+};
+
+// Build a minimal perfect hash table for keys.  Returns an empty table when it fails.
+Table build(const std::vector<uint64_t> &keys) {
+  size_t const n = keys.size();
+  for (size_t dispCount = std::max<size_t>(1, n / 2); dispCount <= n * 4 + 1; dispCount += std::max<size_t>(1, n / 8)) {
+    std::vector<std::vector<size_t>> buckets(dispCount);
+    for (size_t i = 0; i < n; ++i) {
+      buckets[bucket(keys[i], dispCount)].push_back(i);
+    }
+
+    std::vector<size_t> bucketOrder(dispCount);
+    for (size_t i = 0; i < dispCount; ++i) {
+      bucketOrder[i] = i;
+    }
+    std::stable_sort(bucketOrder.begin(), bucketOrder.end(),
+                     [&](size_t a, size_t b) { return buckets[a].size() > buckets[b].size(); });
+
+    Table table;
+    table.displacements.assign(dispCount, 0);
+    table.order.assign(n, n);
+    bool ok = true;
+    for (size_t const b : bucketOrder) {
+      if (buckets[b].empty()) {
+        break;
+      }
+      bool placed = false;
+      for (uint32_t disp = 0; disp <= 0xffff && !placed; ++disp) {
+        std::vector<uint32_t> slots;
+        for (size_t const i : buckets[b]) {
+          uint32_t const s = slot(keys[i], static_cast<uint16_t>(disp), n);
+          if (table.order[s] != n || std::find(slots.begin(), slots.end(), s) != slots.end()) {
+            break;
+          }
+          slots.push_back(s);
+        }
+        if (slots.size() == buckets[b].size()) {
+          for (size_t j = 0; j < slots.size(); ++j) {
+            table.order[slots[j]] = buckets[b][j];
+          }
+          table.displacements[b] = static_cast<uint16_t>(disp);
+          placed = true;
+        }
+      }
+      if (!placed) {
+        ok = false;
+        break;
+      }
+    }
+    if (ok) {
+      return table;
+    }
+  }
+  return {};
+}
+}  // namespace PerfectHash
+
+namespace Eytzinger {
+// Returns Eytzinger (BFS) layout of the sorted array.  order[k - 1] = index of the sorted array for node k (1-based).
+std::vector<size_t> build(size_t n) {
+  std::vector<size_t> order(n);
+  size_t i = 0;
+  // In-order traversal of the implicit binary tree visits nodes in the sorted order.
+  std::vector<size_t> stack;
+  size_t k = 1;
+  while (k <= n || !stack.empty()) {
+    for (; k <= n; k *= 2) {
+      stack.push_back(k);
+    }
+    k = stack.back();
+    stack.pop_back();
+    order[k - 1] = i++;
+    k = k * 2 + 1;
+  }
+  return order;
+}
+}  // namespace Eytzinger
+
 TextTemplate::Dictionary generateTemplateDictionary() {
   struct Language {
     std::string jsonFilename;
@@ -164,19 +259,10 @@ TextTemplate::Dictionary generateTemplateDictionary() {
     return "HCBUDOUX_IMPL_TEMPLATE(" + name + ")";
   };
 
-  const auto itemCodeToString = [](const std::string &tableName, uint64_t encoded) -> std::string {
+  const auto itemCodeToString = [](uint64_t encoded) -> std::string {
     char buf[64];
-    switch (tableName[0]) {
-      case 'U':
-        sprintf(buf, "0x%08x", static_cast<uint32_t>(encoded));
-        return buf;
-      case 'B':  // fallthrough
-      case 'T':
-        sprintf(buf, "UINT64_C(0x%016" PRIx64 ")", encoded);
-        return buf;
-      default:
-        return "";
-    }
+    sprintf(buf, "0x%08x", static_cast<uint32_t>(encoded));
+    return buf;
   };
 
   const auto itemScoreToString = [](int score) -> std::string {
@@ -185,44 +271,300 @@ TextTemplate::Dictionary generateTemplateDictionary() {
     return buf;
   };
 
+  const auto maskToString = [](int mask) -> std::string {
+    char buf[64];
+    sprintf(buf, "0x%02x", mask);
+    return buf;
+  };
+
+  const auto indexToString = [](uint64_t index) -> std::string {
+    char buf[64];
+    sprintf(buf, "%4u", static_cast<unsigned>(index));
+    return buf;
+  };
+
+  const auto itemsToString = [](const std::vector<std::string> &items, int itemsPerLine) -> std::string {
+    std::string str;
+    int count = 0;
+    for (auto const &item : items) {
+      if (count++ % itemsPerLine == 0) {
+        str += "\n        ";
+      }
+      str += item;
+      str += ",";
+    }
+    return str;
+  };
+
+  const auto displacementsToString = [](const std::vector<uint16_t> &displacements) -> std::string {
+    std::string items;
+    int count = 0;
+    for (uint16_t const disp : displacements) {
+      char buf[64];
+      if (count++ % 16 == 0) {
+        items += "\n        ";
+      }
+      sprintf(buf, "%u,", static_cast<unsigned>(disp));
+      items += buf;
+    }
+    return items;
+  };
+
+  const auto indicesToString = [](const std::vector<size_t> &indices, int itemsPerLine) -> std::string {
+    std::string items;
+    int count = 0;
+    for (size_t const index : indices) {
+      char buf[64];
+      if (count++ % itemsPerLine == 0) {
+        items += "\n        ";
+      }
+      sprintf(buf, "%4u,", static_cast<unsigned>(index));
+      items += buf;
+    }
+    return items;
+  };
+
+  // Cases of the switch statement of HCBUDOUX_LOOKUP_SWITCH.  Each case returns the index in the sorted order.
+  const auto casesToString = [](const std::vector<uint64_t> &keys, int casesPerLine) -> std::string {
+    std::string str;
+    for (size_t i = 0; i < keys.size(); ++i) {
+      char buf[64];
+      if (i > 0) {
+        str += i % casesPerLine == 0 ? "\n    " : " ";
+      }
+      sprintf(buf, "case 0x%08x: return %4u;", static_cast<uint32_t>(keys[i]), static_cast<unsigned>(i));
+      str += buf;
+    }
+    return str;
+  };
+
   TextTemplate::Dictionary templateMap;
 
+  // Generate two-level page table of unigram records.
+  //   PageIndex : [codepoint >> 8] = page number.  Page 0 is the shared empty page.  The last entry is always 0.
+  //   Pages     : [page number][codepoint & 0xff] = index of the record (sorted order).
+  const auto generatePageTable = [&](const std::string &prefix, const std::vector<uint64_t> &keys) {
+    size_t const emptyIndex = keys.size();
+    std::vector<size_t> pageIndex(keys.empty() ? 1 : static_cast<size_t>(keys.back() >> 8) + 2, 0);
+    std::vector<size_t> pages(256, emptyIndex);
+    for (size_t i = 0; i < keys.size(); ++i) {
+      size_t &page = pageIndex[static_cast<size_t>(keys[i] >> 8)];
+      if (page == 0) {
+        page = pages.size() / 256;
+        pages.resize(pages.size() + 256, emptyIndex);
+      }
+      pages[page * 256 + static_cast<size_t>(keys[i] & 0xff)] = i;
+    }
+    if (pages.size() / 256 > 256 || emptyIndex > 0xffff) {
+      fprintf(stderr, "codegen: too many pages for %s\n", prefix.c_str());
+      exit(EXIT_FAILURE);
+    }
+    templateMap[generateTemplateName(prefix + ".PageIndex")] = indicesToString(pageIndex, 16);
+    templateMap[generateTemplateName(prefix + ".Pages")] = indicesToString(pages, 16);
+  };
+
+  // Generate columns of the table in sorted order, perfect hash slot order and Eytzinger layout order.
+  //   `HCBUDOUX_IMPL_TEMPLATE(prefix.Column)`, `(prefix.PerfectHash.Column)`, `(prefix.Eytzinger.Column)`
+  //   Column : "Keys", "Scores", ...
+  // It also generates cases of the switch statement and the number of keys.
+  //   `HCBUDOUX_IMPL_TEMPLATE(prefix.Cases)`, `(prefix.Count)`
+  struct Column {
+    std::string name;
+    std::vector<std::string> items;
+    int itemsPerLine;
+  };
+  const auto generateTable = [&](const std::string &prefix, const std::vector<uint64_t> &keys,
+                                 const std::vector<Column> &columns) {
+    PerfectHash::Table const perfectHash = PerfectHash::build(keys);
+    if (perfectHash.order.size() != keys.size()) {
+      fprintf(stderr, "codegen: failed to build perfect hash for %s\n", prefix.c_str());
+      exit(EXIT_FAILURE);
+    }
+
+    const auto generateOrder = [&](const std::string &name, const std::vector<size_t> &order) {
+      for (Column const &column : columns) {
+        std::vector<std::string> orderedItems;
+        for (size_t const i : order) {
+          orderedItems.push_back(column.items[i]);
+        }
+        templateMap[generateTemplateName(name + "." + column.name)] = itemsToString(orderedItems, column.itemsPerLine);
+      }
+    };
+
+    std::vector<size_t> sortedOrder(keys.size());
+    for (size_t i = 0; i < keys.size(); ++i) {
+      sortedOrder[i] = i;
+    }
+    generateOrder(prefix, sortedOrder);
+    generateOrder(prefix + ".PerfectHash", perfectHash.order);
+    generateOrder(prefix + ".Eytzinger", Eytzinger::build(keys.size()));
+    templateMap[generateTemplateName(prefix + ".PerfectHashDisp")] = displacementsToString(perfectHash.displacements);
+    templateMap[generateTemplateName(prefix + ".Cases")] = casesToString(keys, 3);
+    templateMap[generateTemplateName(prefix + ".Count")] = std::to_string(keys.size());
+  };
+
   for (const Language &language : languages) {
     std::string const jsonFilename = "../third_party/budoux/budoux/models/" + language.jsonFilename;
     std::string const json = readFile(jsonFilename);
     Model const model = loadModel({json.data(), strlen(json.data())});
+    std::string const prefix = "_" + language.symbol + "_.";
     int baseScore = 0;
 
+    // Tables are merged by the number of characters of their keys.
+    //   UW1, ..., UW6 -> UW : [codepoint][0..5]  = score of UW1, ..., UW6
+    //   BW1, ..., BW3 -> BW : [codepoints][0..2] = score of BW1, ..., BW3
+    //   TW1, ..., TW4 -> TW : [codepoints][0..3] = score of TW1, ..., TW4
+    struct MergedTable {
+      std::string name;
+      size_t scoreCount;
+      int keysPerLine;
+      int scoresPerLine;
+      std::map<uint64_t, std::vector<int>> records;
+    };
+    MergedTable mergedTables[] = {{"UW", 6, 8, 4, {}}, {"BW", 3, 8, 6, {}}, {"TW", 4, 8, 4, {}}};
+
     for (auto const &table : model) {
       auto const &tableName = table.first;  // "UW1"
       auto const &elements = table.second;  // ["A"] = 1, ["B"] = 2, ...
+      for (MergedTable &mergedTable : mergedTables) {
+        if (tableName.compare(0, 2, mergedTable.name) != 0) {
+          continue;
+        }
+        for (auto const &element : elements) {
+          std::vector<int> &scores = mergedTable.records[element.first];
+          scores.resize(mergedTable.scoreCount);
+          scores[tableName[2] - '1'] = element.second;
+          baseScore += element.second;
+        }
+      }
+    }
 
-      std::string items;
-      int count = 0;
-
-      for (auto const &element : elements) {
-        uint64_t const elementEncodedName = element.first;
-        int const elementScore = element.second;
+    // Participation mask of each character.  These bits must be identical to hcbudoux_impl_mask_* in
+    // hcbudoux.template.h.  Characters which appear only in BW or TW keys are also added to UW (with zero scores) to
+    // hold their masks.  Characters which are not in UW have the empty mask.
+    enum : int {
+      maskBigram0 = 1 << 0,   // 1st character of BW key
+      maskBigram1 = 1 << 1,   // 2nd character of BW key
+      maskTrigram0 = 1 << 2,  // 1st character of TW key
+      maskTrigram1 = 1 << 3,  // 2nd character of TW key
+      maskTrigram2 = 1 << 4,  // 3rd character of TW key
+      maskUnigram = 1 << 5,   // Has UW scores
+    };
+    std::map<uint64_t, int> masks;
+    for (auto const &record : mergedTables[0].records) {
+      masks[record.first] |= maskUnigram;
+    }
+    for (auto const &record : mergedTables[1].records) {
+      masks[(record.first >> 21) & 0x1fffff] |= maskBigram0;
+      masks[record.first & 0x1fffff] |= maskBigram1;
+    }
+    for (auto const &record : mergedTables[2].records) {
+      masks[(record.first >> 42) & 0x1fffff] |= maskTrigram0;
+      masks[(record.first >> 21) & 0x1fffff] |= maskTrigram1;
+      masks[record.first & 0x1fffff] |= maskTrigram2;
+    }
+    for (auto const &mask : masks) {
+      mergedTables[0].records[mask.first].resize(mergedTables[0].scoreCount);
+    }
 
-        if (count++ % 4 == 0) {
-          items += "\n        ";
+    // Bounds of n-gram scores of each character for branch and bound.  They must be identical to
+    // hcbudoux_impl_unigram_bound.
+    //   [codepoint][0..3] = max positive and max negative scores of BW records, and those of TW records, which have the
+    //                       character in their keys.  They are 0 when the character is not in any key.
+    std::map<uint64_t, std::vector<int>> ngramBounds;
+    for (auto const &mask : masks) {
+      ngramBounds[mask.first].resize(4);
+    }
+    for (int t = 1; t <= 2; ++t) {
+      int const length = t + 1;  // BW : 2, TW : 3
+      for (auto const &record : mergedTables[t].records) {
+        for (int i = 0; i < length; ++i) {
+          std::vector<int> &bounds = ngramBounds[(record.first >> (21 * i)) & 0x1fffff];
+          for (int const score : record.second) {
+            bounds[t * 2 - 2] = std::max(bounds[t * 2 - 2], score);
+            bounds[t * 2 - 1] = std::min(bounds[t * 2 - 1], score);
+          }
         }
+      }
+    }
 
-        items += "{";
-        items += itemCodeToString(tableName, elementEncodedName);  // UINT64_C(0x...)
-        items += ",";
-        items += itemScoreToString(elementScore);  // +123
-        items += "},";
-
-        baseScore += elementScore;
+    // Vocabulary ID of a character is the index of its record in the sorted unigram table.
+    // BW and TW keys are IDs in mixed radix (radix is the number of characters) to fit in uint32_t.
+    // The encoding must be identical to hcbudoux_impl_lookup_bigram() and hcbudoux_impl_lookup_trigram().
+    std::map<uint64_t, uint64_t> ids;
+    for (auto const &record : mergedTables[0].records) {
+      uint64_t const id = ids.size();
+      ids[record.first] = id;
+    }
+    uint64_t const radix = ids.size();
+    if (radix * radix * radix > UINT64_C(0x100000000)) {
+      fprintf(stderr, "codegen: too many characters (%u) for %s\n", static_cast<unsigned>(radix), prefix.c_str());
+      exit(EXIT_FAILURE);
+    }
+    for (MergedTable &mergedTable : mergedTables) {
+      int const length = mergedTable.name == "BW" ? 2 : mergedTable.name == "TW" ? 3 : 0;
+      if (length == 0) {
+        continue;
       }
+      std::map<uint64_t, std::vector<int>> records;
+      for (auto const &record : mergedTable.records) {
+        uint64_t key = 0;
+        for (int i = length - 1; i >= 0; --i) {
+          key = key * radix + ids[(record.first >> (21 * i)) & 0x1fffff];
+        }
+        records[key] = record.second;
+      }
+      mergedTable.records = records;
+    }
 
-      std::string const key = generateTemplateName("_" + language.symbol + "_." + tableName);
-      templateMap[key] = items;
+    for (MergedTable const &mergedTable : mergedTables) {
+      std::vector<uint64_t> keys;
+      Column keyColumn = {"Keys", {}, mergedTable.keysPerLine};
+      Column scoreColumn = {"Scores", {}, mergedTable.scoresPerLine};
+      Column maskColumn = {"Masks", {}, 16};
+      Column idColumn = {"Ids", {}, 16};
+      Column boundColumn = {"Bounds", {}, 4};
+      for (auto const &record : mergedTable.records) {
+        std::string item = "{{";  // {{ +1, +2, +3}}
+        for (size_t i = 0; i < record.second.size(); ++i) {
+          if (record.second[i] < INT16_MIN || record.second[i] > INT16_MAX) {
+            fprintf(stderr, "codegen: score %d of %s%s doesn't fit in int16_t\n", record.second[i], prefix.c_str(),
+                    mergedTable.name.c_str());
+            exit(EXIT_FAILURE);
+          }
+          item += (i ? "," : "") + itemScoreToString(record.second[i]);
+        }
+        item += "}}";
+        keys.push_back(record.first);
+        keyColumn.items.push_back(itemCodeToString(record.first));  // 0x...
+        scoreColumn.items.push_back(item);
+        if (mergedTable.name == "UW") {
+          maskColumn.items.push_back(maskToString(masks[record.first]));
+          idColumn.items.push_back(indexToString(ids[record.first]));
+          std::string bound = "{";  // { +1, -2, +3, -4}
+          for (size_t i = 0; i < 4; ++i) {
+            bound += (i ? "," : "") + itemScoreToString(ngramBounds[record.first][i]);
+          }
+          boundColumn.items.push_back(bound + "}");
+        }
+      }
+      if (mergedTable.name == "UW") {
+        // Unigram records are indexed by ID.  Only keys (and their IDs) are ordered by the lookup engine.
+        generateTable(prefix + mergedTable.name, keys, {keyColumn, idColumn});
+        generatePageTable(prefix + mergedTable.name, keys);
+        templateMap[generateTemplateName(prefix + mergedTable.name + ".Scores")] =
+            itemsToString(scoreColumn.items, scoreColumn.itemsPerLine);
+        templateMap[generateTemplateName(prefix + mergedTable.name + ".Masks")] =
+            itemsToString(maskColumn.items, maskColumn.itemsPerLine);
+        templateMap[generateTemplateName(prefix + mergedTable.name + ".Bounds")] =
+            itemsToString(boundColumn.items, boundColumn.itemsPerLine);
+      } else {
+        generateTable(prefix + mergedTable.name, keys, {keyColumn, scoreColumn});
+      }
     }
 
     {
-      std::string const key = generateTemplateName("_" + language.symbol + "_.Base");
+      std::string const key = generateTemplateName(prefix + "Base");
       templateMap[key] = itemScoreToString(-baseScore);
     }
   }
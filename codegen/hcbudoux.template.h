@@ -85,7 +85,7 @@
 
 #ifndef HCBUDOUX_DONT_INCLUDE_STD
 #include <stdbool.h>  // bool, true, false
-#include <stdint.h>   // uint8_t, uint32_t, uint64_t
+#include <stdint.h>   // int16_t, uint8_t, uint16_t, uint32_t, uint64_t, INT32_MIN, INT32_MAX
 #endif
 
 #ifdef __cplusplus
@@ -102,28 +102,74 @@ enum {
   hcbudoux_version_patch = 0,
 };
 
+// Languages of the models.
+typedef enum hcbudoux_lang {
+  hcbudoux_lang_ja,
+  hcbudoux_lang_ja_knbc,
+  hcbudoux_lang_th,
+  hcbudoux_lang_zh_hans,
+  hcbudoux_lang_zh_hant,
+} hcbudoux_lang;
+
+struct hcbudoux_impl_tables;
+
 typedef struct hcbudoux_ctx {
   struct {
-    const uint8_t *utf8_str;
-    int utf8_str_size_in_bytes;
+    const uint8_t *utf8_str;     // UTF-16 or UTF-32 string if encoding is not hcbudoux_impl_encoding_utf8
+    int utf8_str_size_in_bytes;  // Size in code units of the encoding
     int curr_index;
     int last_index;
-    uint32_t utf32s[6];
-    int indices[6];
+    uint32_t window;                            // 4 bits of characters c[0], ..., c[5].  See hcbudoux_impl_window_*
+    const struct hcbudoux_impl_tables *tables;  // Model of the following records
+    const int *offsets;                         // Offsets of spans of hcbudoux_init_utf32() or null
+    int unigrams[6];                            // ID (index of unigram record) of c[i]
+    uint8_t masks[6];                           // Participation mask of c[i]
+    bool nul_terminated;                        // '\0' of utf8_str is not found yet.  See hcbudoux_impl_decode_ctx()
+    uint8_t encoding;                           // hcbudoux_impl_encoding of utf8_str
+    int bigrams[4];                             // Index of bigram record of c[i+1], c[i+2]
+    int trigrams[4];                            // Index of trigram record of c[i], ..., c[i+2]
+    int stream_base;                            // Offset of utf8_str (the chunk of hcbudoux_feed()) in the stream
+    int stream_size;                            // Size of utf8_str in bytes
+    uint8_t stream_pending[3];                  // Bytes before stream_base which are not decoded yet
+    uint8_t stream_pending_size;                // Number of stream_pending bytes
   } impl;
 } hcbudoux_ctx;
 
+// Offset and length are in units of the string: bytes of UTF-8, code units of hcbudoux_init_utf16(), and code points
+// (or offsets) of hcbudoux_init_utf32().
 typedef struct hcbudoux_span {
-  int offset;  // public member: Offset in bytes from the beginning of utf8_str.
-  int length;  // public member: Length in bytes.
+  int offset;  // public member: Offset from the beginning of utf8_str.
+  int length;  // public member: Length.
 } hcbudoux_span;
 
 // Initialize a parser context with a UTF-8 string.
 // utf8_str is encoded in UTF-8.  The lifetime of utf8_str is longer than hcbudoux_ctx.
+// Ill-formed UTF-8 sequences are segmented as U+FFFD.  Spans always cover the original bytes.
 // We don't need to "close" hcbudoux_ctx since it doesn't allocate dynamic resources.
-// hcbudoux doesn't require that utf8_str is terminated with '\0'.
+// hcbudoux doesn't require that utf8_str is terminated with '\0'.  When utf8_str_size_in_bytes is -1, utf8_str is
+// terminated with '\0' and hcbudoux finds it while segmenting, so the caller doesn't need strlen().
 void hcbudoux_init(hcbudoux_ctx *ctx, const void *utf8_str, int utf8_str_size_in_bytes);
 
+// Initialize a parser context with a UTF-8 string and the model of the language for hcbudoux_getnext().
+// The model is bound to ctx once, so hcbudoux_getnext() doesn't dispatch on the language.
+// When the model of lang is disabled (HCBUDOUX_USE_*), hcbudoux_getnext() returns the whole string as one span.
+void hcbudoux_init_lang(hcbudoux_ctx *ctx, hcbudoux_lang lang, const void *utf8_str, int utf8_str_size_in_bytes);
+
+// Initialize a parser context with a UTF-16 string in native byte order (char16_t, or wchar_t on Windows).
+// The size is in code units, and spans are in code units too.  -1 means utf16_str is terminated with 0.
+// Surrogate pairs are decoded as one character.  Unpaired surrogates are segmented as U+FFFD.
+void hcbudoux_init_utf16(hcbudoux_ctx *ctx, const void *utf16_str, int utf16_str_size_in_units);
+void hcbudoux_init_lang_utf16(hcbudoux_ctx *ctx, hcbudoux_lang lang, const void *utf16_str,
+                              int utf16_str_size_in_units);
+
+// Initialize a parser context with decoded code points, for example the output of a text shaper.
+// Spans are in indices of code points.  If offsets is not null, spans are in its units instead: offsets[i] is the
+// offset of utf32_str[i] and offsets[utf32_str_length] is the end of the string.  -1 means utf32_str is terminated
+// with 0.  Surrogates and code points above U+10FFFF are segmented as U+FFFD.
+void hcbudoux_init_utf32(hcbudoux_ctx *ctx, const uint32_t *utf32_str, const int *offsets, int utf32_str_length);
+void hcbudoux_init_lang_utf32(hcbudoux_ctx *ctx, hcbudoux_lang lang, const uint32_t *utf32_str, const int *offsets,
+                              int utf32_str_length);
+
 // Get the next string view of the specific language.
 // Returns false when the parser reaches the end of utf8_str.
 // When it returns true, span contains a valid offset and length of the string view.
@@ -136,6 +182,76 @@ bool hcbudoux_getnext_th(hcbudoux_ctx *ctx, hcbudoux_span *span);
 bool hcbudoux_getnext_zh_hans(hcbudoux_ctx *ctx, hcbudoux_span *span);
 bool hcbudoux_getnext_zh_hant(hcbudoux_ctx *ctx, hcbudoux_span *span);
 
+// Get the next string view with the model which is bound by hcbudoux_init_lang().
+// When ctx is initialized by hcbudoux_init(), it has no model and returns the whole string as one span.
+bool hcbudoux_getnext(hcbudoux_ctx *ctx, hcbudoux_span *span);
+
+// Get the ends of the next spans at once.  offsets[i] is span.offset + span.length of the spans which
+// hcbudoux_getnext() returns, so the last offset of the string is its end.  Returns the number of offsets (at most
+// capacity), and 0 at the end of the string.  When offsets is full, the next call continues from the next span.
+// UTF-8 strings of known size are segmented by blocks of characters instead of span by span.
+int hcbudoux_getbreaks(hcbudoux_ctx *ctx, int *offsets, int capacity);
+
+// Get the ends of all spans of the UTF-8 string with the model of lang at once.  It's the same as hcbudoux_init_lang()
+// and hcbudoux_getbreaks().  Use them to resume when the number of spans may exceed capacity.
+int hcbudoux_find_breaks(hcbudoux_lang lang, const void *utf8_str, int utf8_str_size_in_bytes, int *offsets,
+                         int capacity);
+
+// Set the breaks of the rest of the string to the bitmap.  Bit i (bitmap[i / 64] >> (i % 64) & 1) is set when a span
+// begins at offset i except the first span of the string, so it has one bit per unit of the spans (byte of UTF-8, code
+// unit of UTF-16, code point or unit of offsets of hcbudoux_init_utf32()).  Bits are ORed to bitmap: it must have
+// (end + 63) / 64 words, where end is the end of the last span (the size, the length of a NUL-terminated string or
+// offsets[utf32_str_length]), and the caller clears (or fills) it.  Returns the number of breaks.  Like
+// hcbudoux_getbreaks(), UTF-8 strings of known size are segmented by blocks.
+int hcbudoux_getbreaks_bitmap(hcbudoux_ctx *ctx, uint64_t *bitmap);
+
+// Same as hcbudoux_init_lang() and hcbudoux_getbreaks_bitmap().
+int hcbudoux_find_breaks_bitmap(hcbudoux_lang lang, const void *utf8_str, int utf8_str_size_in_bytes,
+                                uint64_t *bitmap);
+
+// Get the scores of the next characters.  scores[i] is the score of the break before the i-th character: a span begins
+// at the character when its score is positive, except the first character of the string and U+0000.  The score is 0
+// without a model.  When offsets is not null, offsets[i] is the offset of the character.  Returns the number of
+// characters (at most capacity), and 0 at the end of the string.  Don't mix it with hcbudoux_getnext() on the same ctx.
+int hcbudoux_getscores(hcbudoux_ctx *ctx, int *scores, int *offsets, int capacity);
+
+// Same as hcbudoux_init_lang() and hcbudoux_getscores().
+int hcbudoux_find_scores(hcbudoux_lang lang, const void *utf8_str, int utf8_str_size_in_bytes, int *scores,
+                         int *offsets, int capacity);
+
+// Set the breaks of the rest of the string for several thresholds at once.  The string is decoded and scored once, and
+// a character is a break of thresholds[k] when its score is greater than thresholds[k].  Threshold 0 is the breaks of
+// hcbudoux_getnext(), and a larger threshold has fewer (coarser) breaks.  bitmaps[k] is the bitmap of thresholds[k] in
+// the same format as hcbudoux_getbreaks_bitmap().  There's no break without a model.  Don't mix it with
+// hcbudoux_getnext() on the same ctx.
+void hcbudoux_getbreaks_thresholds(hcbudoux_ctx *ctx, const int *thresholds, int threshold_count,
+                                   uint64_t *const *bitmaps);
+
+// Same as hcbudoux_init_lang() and hcbudoux_getbreaks_thresholds().
+void hcbudoux_find_breaks_thresholds(hcbudoux_lang lang, const void *utf8_str, int utf8_str_size_in_bytes,
+                                     const int *thresholds, int threshold_count, uint64_t *const *bitmaps);
+
+// Initialize a parser context with the model of the language for a UTF-8 stream which is fed in chunks.
+// hcbudoux_feed() gives the next chunk of the stream.  A chunk may end in the middle of a UTF-8 sequence.
+// hcbudoux_getnext() (and hcbudoux_getbreaks(), ...) returns false when it needs the next chunk.  Call it until it
+// returns false before the next hcbudoux_feed(), then the chunk may be released.  hcbudoux_finish() marks the end of
+// the stream, and hcbudoux_getnext() returns the rest of the spans.
+// Spans are offsets in the stream, and they are the same as the spans of the whole stream in one buffer.  ctx keeps the
+// window of 6 characters and a few bytes of a split sequence, so it needs constant memory.  The size of the stream
+// must be less than INT32_MAX bytes.  The language can't be changed: hcbudoux_getnext_*() of another language returns
+// false with span->offset -1 (the end of a chunk has offset 0) and doesn't change ctx.
+//
+//     hcbudoux_init_stream(&ctx, hcbudoux_lang_ja);
+//     while ((n = read_chunk(chunk)) > 0) {
+//       hcbudoux_feed(&ctx, chunk, n);
+//       while (hcbudoux_getnext(&ctx, &span)) { ... }
+//     }
+//     hcbudoux_finish(&ctx);
+//     while (hcbudoux_getnext(&ctx, &span)) { ... }
+void hcbudoux_init_stream(hcbudoux_ctx *ctx, hcbudoux_lang lang);
+void hcbudoux_feed(hcbudoux_ctx *ctx, const void *utf8_chunk, int utf8_chunk_size_in_bytes);
+void hcbudoux_finish(hcbudoux_ctx *ctx);
+
 //
 // ^^^^^^^^^^^^^^^^^^^^^^
 //   hcbudoux Public API
@@ -159,448 +275,2165 @@ bool hcbudoux_getnext_zh_hant(hcbudoux_ctx *ctx, hcbudoux_span *span);
 #define HCBUDOUX_USE_ZH_HANT 1
 #endif
 
+// Lookup engine
+#if defined(HCBUDOUX_LOOKUP_PERFECT_HASH) && (HCBUDOUX_LOOKUP_PERFECT_HASH)
+#define HCBUDOUX_IMPL_PERFECT_HASH 1
+#else
+#define HCBUDOUX_IMPL_PERFECT_HASH 0
+#endif
+
+#if defined(HCBUDOUX_LOOKUP_EYTZINGER) && (HCBUDOUX_LOOKUP_EYTZINGER) && !HCBUDOUX_IMPL_PERFECT_HASH
+#define HCBUDOUX_IMPL_EYTZINGER 1
+#else
+#define HCBUDOUX_IMPL_EYTZINGER 0
+#endif
+
+#if defined(HCBUDOUX_LOOKUP_UNIGRAM_PAGE_TABLE) && (HCBUDOUX_LOOKUP_UNIGRAM_PAGE_TABLE)
+#define HCBUDOUX_IMPL_UNIGRAM_PAGE_TABLE 1
+#else
+#define HCBUDOUX_IMPL_UNIGRAM_PAGE_TABLE 0
+#endif
+
+#if defined(HCBUDOUX_LOOKUP_SWITCH) && (HCBUDOUX_LOOKUP_SWITCH) && !HCBUDOUX_IMPL_PERFECT_HASH && \
+    !HCBUDOUX_IMPL_EYTZINGER && !HCBUDOUX_IMPL_UNIGRAM_PAGE_TABLE
+#define HCBUDOUX_IMPL_SWITCH 1
+#else
+#define HCBUDOUX_IMPL_SWITCH 0
+#endif
+
+#if defined(HCBUDOUX_BRANCH_AND_BOUND) && (HCBUDOUX_BRANCH_AND_BOUND)
+#define HCBUDOUX_IMPL_BRANCH_AND_BOUND 1
+#else
+#define HCBUDOUX_IMPL_BRANCH_AND_BOUND 0
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define HCBUDOUX_IMPL_MAYBE_UNUSED __attribute__((unused))
+#define HCBUDOUX_IMPL_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define HCBUDOUX_IMPL_MAYBE_UNUSED
+#define HCBUDOUX_IMPL_NOINLINE __declspec(noinline)
+#else
+#define HCBUDOUX_IMPL_MAYBE_UNUSED
+#define HCBUDOUX_IMPL_NOINLINE
+#endif
+
+// SIMD lookup.  Since it includes <immintrin.h> or <emmintrin.h>, HCBUDOUX_DONT_INCLUDE_STD disables it.
+#if defined(__AVX2__) && !defined(HCBUDOUX_DONT_INCLUDE_STD) && \
+    !(defined(HCBUDOUX_DISABLE_AVX2) && (HCBUDOUX_DISABLE_AVX2))
+#define HCBUDOUX_IMPL_AVX2 1
+#include <immintrin.h>  // _mm256_*
+#else
+#define HCBUDOUX_IMPL_AVX2 0
+#endif
+
+#if (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && (_M_IX86_FP >= 2))) && \
+    !defined(HCBUDOUX_DONT_INCLUDE_STD) && !(defined(HCBUDOUX_DISABLE_SSE2) && (HCBUDOUX_DISABLE_SSE2))
+#define HCBUDOUX_IMPL_SSE2 1
+#include <emmintrin.h>  // _mm_*
+#else
+#define HCBUDOUX_IMPL_SSE2 0
+#endif
+
+// Runtime dispatch of block segmentation kernels.  x86 kernels are compiled with target attributes (GCC, clang) or
+// without /arch (MSVC), and hcbudoux_impl_get_kernel() selects the best kernel of the host with cpuid at first use.
+// Since it includes <cpuid.h> or <intrin.h>, HCBUDOUX_DONT_INCLUDE_STD disables it.
+#if (defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)) &&  \
+    (defined(__GNUC__) || defined(__clang__) || defined(_MSC_VER)) && !defined(HCBUDOUX_DONT_INCLUDE_STD) && \
+    !(defined(HCBUDOUX_DISABLE_DISPATCH) && (HCBUDOUX_DISABLE_DISPATCH))
+#define HCBUDOUX_IMPL_DISPATCH 1
+#if defined(__GNUC__) || defined(__clang__)
+#include <cpuid.h>      // __cpuid_count
+#include <immintrin.h>  // _mm_*, _mm256_*, _mm512_*
+#define HCBUDOUX_IMPL_TARGET(isa) __attribute__((target(isa)))
+#else
+#include <intrin.h>     // __cpuidex
+#include <immintrin.h>  // _xgetbv, _mm_*, _mm256_*, _mm512_*
+#define HCBUDOUX_IMPL_TARGET(isa)
+#endif
+#else
+#define HCBUDOUX_IMPL_DISPATCH 0
+#endif
+
+// Linear scan threshold of the sorted lookup.  0 disables linear scan.
+#if defined(HCBUDOUX_LINEAR_SCAN_THRESHOLD)
+#define HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD (HCBUDOUX_LINEAR_SCAN_THRESHOLD)
+#else
+#define HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD 16
+#endif
+
+#if (HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD) < 0 || (HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD) % 8 != 0
+#error "HCBUDOUX_LINEAR_SCAN_THRESHOLD must be a multiple of 8"
+#endif
+
+// Encoding of the string of hcbudoux_ctx.
+enum hcbudoux_impl_encoding {
+  hcbudoux_impl_encoding_utf8,
+  hcbudoux_impl_encoding_utf16,
+  hcbudoux_impl_encoding_utf32,
+  hcbudoux_impl_encoding_utf8_stream,  // Chunks of hcbudoux_feed()
+};
+
 //
 // Public API : Initialize
 //
 void hcbudoux_init(hcbudoux_ctx *ctx, const void *utf8_str, int utf8_str_size_in_bytes) {
   ctx->impl.utf8_str = (const uint8_t *)utf8_str;
-  ctx->impl.utf8_str_size_in_bytes = utf8_str_size_in_bytes;
+  // -1 is a NUL-terminated string.  Other negative sizes are an empty string.
+  ctx->impl.utf8_str_size_in_bytes = utf8_str_size_in_bytes == -1 ? INT32_MAX
+                                     : utf8_str_size_in_bytes < 0 ? 0
+                                                                  : utf8_str_size_in_bytes;
+  ctx->impl.nul_terminated = utf8_str_size_in_bytes == -1;
+  ctx->impl.encoding = hcbudoux_impl_encoding_utf8;
   ctx->impl.curr_index = 0;
   ctx->impl.last_index = 0;
-  for (int i = 0, n = (int)(sizeof(ctx->impl.utf32s) / sizeof(ctx->impl.utf32s[0])); i < n; ++i) {
-    ctx->impl.utf32s[i] = 0;
+  ctx->impl.window = 0;
+  ctx->impl.tables = 0;
+  ctx->impl.offsets = 0;
+  ctx->impl.stream_base = 0;
+  ctx->impl.stream_size = 0;
+  ctx->impl.stream_pending_size = 0;
+  for (int i = 0, n = (int)(sizeof(ctx->impl.unigrams) / sizeof(ctx->impl.unigrams[0])); i < n; ++i) {
+    ctx->impl.unigrams[i] = 0;
+  }
+  for (int i = 0, n = (int)(sizeof(ctx->impl.masks) / sizeof(ctx->impl.masks[0])); i < n; ++i) {
+    ctx->impl.masks[i] = 0;
+  }
+  for (int i = 0, n = (int)(sizeof(ctx->impl.bigrams) / sizeof(ctx->impl.bigrams[0])); i < n; ++i) {
+    ctx->impl.bigrams[i] = 0;
   }
-  for (int i = 0, n = (int)(sizeof(ctx->impl.indices) / sizeof(ctx->impl.indices[0])); i < n; ++i) {
-    ctx->impl.indices[i] = 0;
+  for (int i = 0, n = (int)(sizeof(ctx->impl.trigrams) / sizeof(ctx->impl.trigrams[0])); i < n; ++i) {
+    ctx->impl.trigrams[i] = 0;
   }
 }
 
 //
 // Utility functions
 //
+// Same as hcbudoux_lang.
 typedef enum hcbudoux_impl_lang {
-  hcbudoux_impl_lang_ja,
-  hcbudoux_impl_lang_ja_knbc,
-  hcbudoux_impl_lang_th,
-  hcbudoux_impl_lang_zh_hans,
-  hcbudoux_impl_lang_zh_hant,
+  hcbudoux_impl_lang_ja = hcbudoux_lang_ja,
+  hcbudoux_impl_lang_ja_knbc = hcbudoux_lang_ja_knbc,
+  hcbudoux_impl_lang_th = hcbudoux_lang_th,
+  hcbudoux_impl_lang_zh_hans = hcbudoux_lang_zh_hans,
+  hcbudoux_impl_lang_zh_hant = hcbudoux_lang_zh_hant,
 } hcbudoux_impl_lang;
 
-typedef struct hcbudoux_impl_item1 {
-  uint32_t var;
-  int score;
-} hcbudoux_impl_item1;
+typedef struct hcbudoux_impl_unigram {
+  int16_t scores[6];  // Scores of UW1, ..., UW6
+} hcbudoux_impl_unigram;
 
-typedef struct hcbudoux_impl_item2 {
-  uint64_t var;
-  int score;
-} hcbudoux_impl_item2;
+// Participation mask of a character.  n-gram lookups are skipped when a character doesn't have the bit of its position.
+// These bits must be identical to mask* in codegen.cpp.  Characters which are not in the model have the empty mask.
+enum {
+  hcbudoux_impl_mask_bigram0 = 1 << 0,   // 1st character of BW key
+  hcbudoux_impl_mask_bigram1 = 1 << 1,   // 2nd character of BW key
+  hcbudoux_impl_mask_trigram0 = 1 << 2,  // 1st character of TW key
+  hcbudoux_impl_mask_trigram1 = 1 << 3,  // 2nd character of TW key
+  hcbudoux_impl_mask_trigram2 = 1 << 4,  // 3rd character of TW key
+  hcbudoux_impl_mask_unigram = 1 << 5,   // Has UW scores
+};
 
-typedef struct hcbudoux_impl_item3 {
-  uint64_t var;
-  int score;
-} hcbudoux_impl_item3;
+// Bounds of n-gram scores of a character for branch and bound.  They are max positive and max negative scores of all
+// bigram (trigram) records which have the character in their keys.
+typedef struct hcbudoux_impl_unigram_bound {
+  int16_t bigram_max;
+  int16_t bigram_min;
+  int16_t trigram_max;
+  int16_t trigram_min;
+} hcbudoux_impl_unigram_bound;
 
-static int hcbudoux_impl_find1(const hcbudoux_impl_item1 *base, int len, uint32_t x) {
-  while (len > 1) {
-    int const half = len / 2;
-    base += (base[half - 1].var < x) * half;
-    len -= half;
+typedef struct hcbudoux_impl_bigram {
+  int16_t scores[3];  // Scores of BW1, ..., BW3
+} hcbudoux_impl_bigram;
+
+typedef struct hcbudoux_impl_trigram {
+  int16_t scores[4];  // Scores of TW1, ..., TW4
+} hcbudoux_impl_trigram;
+
+// Lookup table.
+// Tables are structure of arrays.  keys[i] is the key of items[i], and items[count] is the empty record which has no
+// score.  Since a lookup searches keys[] only, it touches densely packed keys.
+//
+// keys[] is sorted, ordered by perfect hash slot when HCBUDOUX_LOOKUP_PERFECT_HASH is enabled, or ordered by
+// Eytzinger layout (keys[k - 1] is the node k of the implicit binary tree) when HCBUDOUX_LOOKUP_EYTZINGER is enabled.
+// With HCBUDOUX_LOOKUP_UNIGRAM_PAGE_TABLE, the unigram table is sorted and has two-level page table.
+// With HCBUDOUX_LOOKUP_SWITCH, keys[] is sorted and find() is the generated switch statement which returns the index.
+//
+// The unigram table has all characters of the model including characters which appear only in n-gram keys.
+// The ID of a character is the index of its record in the sorted table, and ID count is the unknown character.
+// Records are always sorted.  When keys[] is not sorted, ids[i] is the ID of keys[i].
+// masks[id] is the participation mask of the character, and masks[count] is the empty mask.
+// With HCBUDOUX_BRANCH_AND_BOUND, bounds[id] is the bounds of n-gram scores of the character and bounds[count] is 0.
+//
+// Keys of the bigram and trigram tables are IDs in mixed radix.  The radix is the count of the unigram table.
+typedef struct hcbudoux_impl_unigram_table {
+  const uint32_t *keys;
+  const uint16_t *ids;
+  const hcbudoux_impl_unigram *items;
+  const uint8_t *masks;
+  const hcbudoux_impl_unigram_bound *bounds;
+  int count;
+  const uint16_t *disp;  // Perfect hash displacements
+  int disp_count;
+  const uint8_t *page_index;  // [codepoint >> 8] = page number.  The last entry is the empty page.
+  int page_index_count;
+  const uint16_t *pages;  // [page number * 256 + (codepoint & 0xff)] = ID
+  int page_count;
+  int (*find)(uint32_t x);  // Switch lookup
+} hcbudoux_impl_unigram_table;
+
+typedef struct hcbudoux_impl_bigram_table {
+  const uint32_t *keys;
+  const hcbudoux_impl_bigram *items;
+  int count;
+  const uint16_t *disp;
+  int disp_count;
+  int (*find)(uint32_t x);
+} hcbudoux_impl_bigram_table;
+
+typedef struct hcbudoux_impl_trigram_table {
+  const uint32_t *keys;
+  const hcbudoux_impl_trigram *items;
+  int count;
+  const uint16_t *disp;
+  int disp_count;
+  int (*find)(uint32_t x);
+} hcbudoux_impl_trigram_table;
+
+typedef struct hcbudoux_impl_tables {
+  int base_score;
+  hcbudoux_impl_unigram_table uw;
+  hcbudoux_impl_bigram_table bw;
+  hcbudoux_impl_trigram_table tw;
+} hcbudoux_impl_tables;
+
+#define HCBUDOUX_IMPL_COUNTOF(a) ((int)(sizeof(a) / sizeof(a[0])))
+#define HCBUDOUX_IMPL_EMPTY_RECORD \
+  {                                \
+    { 0 }                          \
+  }
+// HCBUDOUX_IMPL_TABLE(lang, name) initializes the table of the arrays name, name##_keys, ... of the model lang.
+#if HCBUDOUX_IMPL_PERFECT_HASH
+#define HCBUDOUX_IMPL_TABLE(lang, name) \
+  { name##_keys, name, HCBUDOUX_IMPL_COUNTOF(name##_keys), name##_disp, HCBUDOUX_IMPL_COUNTOF(name##_disp), 0 }
+#elif HCBUDOUX_IMPL_SWITCH
+#define HCBUDOUX_IMPL_TABLE(lang, name) \
+  { name##_keys, name, HCBUDOUX_IMPL_COUNTOF(name##_keys), 0, 0, hcbudoux_impl_switch_##lang##_##name }
+#else
+#define HCBUDOUX_IMPL_TABLE(lang, name) \
+  { name##_keys, name, HCBUDOUX_IMPL_COUNTOF(name##_keys), 0, 0, 0 }
+#endif
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+#define HCBUDOUX_IMPL_UNIGRAM_BOUNDS(name) name##_bounds
+#else
+#define HCBUDOUX_IMPL_UNIGRAM_BOUNDS(name) 0
+#endif
+#if HCBUDOUX_IMPL_UNIGRAM_PAGE_TABLE
+#define HCBUDOUX_IMPL_UNIGRAM_TABLE(lang, name)                                                                       \
+  {                                                                                                                   \
+    name##_keys, 0, name, name##_masks, HCBUDOUX_IMPL_UNIGRAM_BOUNDS(name), HCBUDOUX_IMPL_COUNTOF(name##_keys), 0, 0, \
+        name##_page_index, HCBUDOUX_IMPL_COUNTOF(name##_page_index), name##_pages,                                    \
+        HCBUDOUX_IMPL_COUNTOF(name##_pages) / 256, 0                                                                  \
+  }
+#elif HCBUDOUX_IMPL_PERFECT_HASH
+#define HCBUDOUX_IMPL_UNIGRAM_TABLE(lang, name)                                                            \
+  {                                                                                                        \
+    name##_keys, name##_ids, name, name##_masks, HCBUDOUX_IMPL_UNIGRAM_BOUNDS(name),                       \
+        HCBUDOUX_IMPL_COUNTOF(name##_keys), name##_disp, HCBUDOUX_IMPL_COUNTOF(name##_disp), 0, 0, 0, 0, 0 \
+  }
+#elif HCBUDOUX_IMPL_EYTZINGER
+#define HCBUDOUX_IMPL_UNIGRAM_TABLE(lang, name)                                      \
+  {                                                                                  \
+    name##_keys, name##_ids, name, name##_masks, HCBUDOUX_IMPL_UNIGRAM_BOUNDS(name), \
+        HCBUDOUX_IMPL_COUNTOF(name##_keys), 0, 0, 0, 0, 0, 0, 0                      \
+  }
+#elif HCBUDOUX_IMPL_SWITCH
+#define HCBUDOUX_IMPL_UNIGRAM_TABLE(lang, name)                                                                       \
+  {                                                                                                                   \
+    name##_keys, 0, name, name##_masks, HCBUDOUX_IMPL_UNIGRAM_BOUNDS(name), HCBUDOUX_IMPL_COUNTOF(name##_keys), 0, 0, \
+        0, 0, 0, 0, hcbudoux_impl_switch_##lang##_##name                                                              \
   }
-  return base->var == x ? base->score : 0;
+#else
+#define HCBUDOUX_IMPL_UNIGRAM_TABLE(lang, name)                                                                       \
+  {                                                                                                                   \
+    name##_keys, 0, name, name##_masks, HCBUDOUX_IMPL_UNIGRAM_BOUNDS(name), HCBUDOUX_IMPL_COUNTOF(name##_keys), 0, 0, \
+        0, 0, 0, 0, 0                                                                                                 \
+  }
+#endif
+
+#if HCBUDOUX_IMPL_EYTZINGER
+#if defined(__GNUC__) || defined(__clang__)
+#define HCBUDOUX_IMPL_PREFETCH(p) __builtin_prefetch(p)
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86)) && !defined(HCBUDOUX_DONT_INCLUDE_STD)
+#include <intrin.h>  // _mm_prefetch
+#define HCBUDOUX_IMPL_PREFETCH(p) _mm_prefetch((const char *)(p), _MM_HINT_T0)
+#else
+#define HCBUDOUX_IMPL_PREFETCH(p) ((void)(p))
+#endif
+
+// Eytzinger layout search prefetches descendants of the node k which share a cache line.
+// Descendants of the node k at the 4th level are keys[k * 16 - 1], ..., keys[k * 16 + 14] (16 x uint32_t).
+static int hcbudoux_impl_eytzinger_prefetch_index(int k, int count) {
+  int const i = k * 16 - 1;
+  return i < count ? i : count - 1;
 }
+#endif
 
-static int hcbudoux_impl_find2(const hcbudoux_impl_item2 *base, int len, uint32_t x0, uint32_t x1) {
-  uint64_t const x = ((uint64_t)x1) | (((uint64_t)x0) << 21);
-  while (len > 1) {
-    int const half = len / 2;
-    base += (base[half - 1].var < x) * half;
-    len -= half;
+#if HCBUDOUX_IMPL_PERFECT_HASH
+// Minimal perfect hash (hash and displace).
+// These functions must be identical to PerfectHash::bucket() and slot() in codegen.cpp.
+static uint32_t hcbudoux_impl_phash_fast_range(uint64_t h, int n) {
+  return (uint32_t)(((h >> 32) * (uint64_t)n) >> 32);
+}
+
+static int hcbudoux_impl_phash_slot(uint64_t x, const uint16_t *disp, int disp_count, int count) {
+  uint64_t const h = x * UINT64_C(0x9e3779b97f4a7c15);
+  uint16_t const d = disp[hcbudoux_impl_phash_fast_range(h, disp_count)];
+  return (int)hcbudoux_impl_phash_fast_range((h ^ d) * UINT64_C(0xc2b2ae3d27d4eb4f), count);
+}
+#endif
+
+#if HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD > 0 && !HCBUDOUX_IMPL_PERFECT_HASH && !HCBUDOUX_IMPL_EYTZINGER && \
+    !HCBUDOUX_IMPL_SWITCH
+// Returns the number of keys which are less than x in keys[0], ..., keys[HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD - 1].
+// It compares all keys at once instead of dependent branches.  Keys are biased since SIMD compare is signed.
+static int hcbudoux_impl_count_less(const uint32_t *keys, uint32_t x) {
+#if HCBUDOUX_IMPL_AVX2
+  __m256i const bias = _mm256_set1_epi32(INT32_MIN);
+  __m256i const v = _mm256_xor_si256(_mm256_set1_epi32((int)x), bias);
+  __m256i sum = _mm256_setzero_si256();
+  for (int i = 0; i < HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD; i += 8) {
+    __m256i const k = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(const void *)&keys[i]), bias);
+    sum = _mm256_sub_epi32(sum, _mm256_cmpgt_epi32(v, k));
+  }
+  __m128i s = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+  return _mm_cvtsi128_si32(s);
+#elif HCBUDOUX_IMPL_SSE2
+  __m128i const bias = _mm_set1_epi32(INT32_MIN);
+  __m128i const v = _mm_xor_si128(_mm_set1_epi32((int)x), bias);
+  __m128i s = _mm_setzero_si128();
+  for (int i = 0; i < HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD; i += 4) {
+    __m128i const k = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(const void *)&keys[i]), bias);
+    s = _mm_sub_epi32(s, _mm_cmpgt_epi32(v, k));
+  }
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0x4e));
+  s = _mm_add_epi32(s, _mm_shuffle_epi32(s, 0xb1));
+  return _mm_cvtsi128_si32(s);
+#else
+  int less = 0;
+  for (int i = 0; i < HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD; ++i) {
+    less += keys[i] < x;
   }
-  return base->var == x ? base->score : 0;
+  return less;
+#endif
 }
+#endif
 
-static int hcbudoux_impl_find3(const hcbudoux_impl_item3 *base, int len, uint32_t x0, uint32_t x1, uint32_t x2) {
-  uint64_t const x = ((uint64_t)x2) | (((uint64_t)x1) << 21) | (((uint64_t)x0) << 42);
+#if !HCBUDOUX_IMPL_SWITCH
+// Returns index of x in keys[].  Returns count if x is not found.
+static int hcbudoux_impl_find_key(const uint32_t *keys, int count, const uint16_t *disp, int disp_count, uint32_t x) {
+#if HCBUDOUX_IMPL_PERFECT_HASH
+  int const slot = hcbudoux_impl_phash_slot(x, disp, disp_count, count);
+  return keys[slot] == x ? slot : count;
+#elif HCBUDOUX_IMPL_EYTZINGER
+  int found = 0;  // The last node which is not less than x
+  int k = 1;
+  (void)disp;
+  (void)disp_count;
+  while (k <= count) {
+    HCBUDOUX_IMPL_PREFETCH(&keys[hcbudoux_impl_eytzinger_prefetch_index(k, count)]);
+    int const less = keys[k - 1] < x;
+    found = less ? found : k;
+    k = k * 2 + less;
+  }
+  int const i = found ? found - 1 : count;
+  return i < count && keys[i] == x ? i : count;
+#else
+  const uint32_t *base = keys;
+  int len = count;
+  (void)disp;
+  (void)disp_count;
+#if HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD > 0
+  if (count >= HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD) {
+    // Binary search narrows down the range to the threshold, and linear scan counts the keys which are less than x.
+    // The first key which is not less than x is in base[0], ..., base[len].  Since keys before base are less than x,
+    // the scan window can be moved backward to stay in keys[].
+    while (len > HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD) {
+      int const half = len / 2;
+      base += (base[half - 1] < x) * half;
+      len -= half;
+    }
+    int const last = count - HCBUDOUX_IMPL_LINEAR_SCAN_THRESHOLD;
+    int const first = (int)(base - keys) < last ? (int)(base - keys) : last;
+    int const i = first + hcbudoux_impl_count_less(&keys[first], x);
+    return i < count && keys[i] == x ? i : count;
+  }
+#endif
   while (len > 1) {
     int const half = len / 2;
-    base += (base[half - 1].var < x) * half;
+    base += (base[half - 1] < x) * half;
     len -= half;
   }
-  return base->var == x ? base->score : 0;
-}
-
-static int hcbudoux_impl_compute_score_from_tables(
-    int base_score, const hcbudoux_impl_item1 *uw1, int uw1_count, const hcbudoux_impl_item1 *uw2, int uw2_count,
-    const hcbudoux_impl_item1 *uw3, int uw3_count, const hcbudoux_impl_item1 *uw4, int uw4_count,
-    const hcbudoux_impl_item1 *uw5, int uw5_count, const hcbudoux_impl_item1 *uw6, int uw6_count,
-    const hcbudoux_impl_item2 *bw1, int bw1_count, const hcbudoux_impl_item2 *bw2, int bw2_count,
-    const hcbudoux_impl_item2 *bw3, int bw3_count, const hcbudoux_impl_item3 *tw1, int tw1_count,
-    const hcbudoux_impl_item3 *tw2, int tw2_count, const hcbudoux_impl_item3 *tw3, int tw3_count,
-    const hcbudoux_impl_item3 *tw4, int tw4_count, uint32_t utf32_prev3, uint32_t utf32_prev2, uint32_t utf32_prev1,
-    uint32_t utf32_current, uint32_t utf32_next1, uint32_t utf32_next2) {
-  int const sum = hcbudoux_impl_find1(uw1, uw1_count, utf32_prev3) + hcbudoux_impl_find1(uw2, uw2_count, utf32_prev2) +
-                  hcbudoux_impl_find1(uw3, uw3_count, utf32_prev1) +
-                  hcbudoux_impl_find1(uw4, uw4_count, utf32_current) +
-                  hcbudoux_impl_find1(uw5, uw5_count, utf32_next1) + hcbudoux_impl_find1(uw6, uw6_count, utf32_next2) +
-                  hcbudoux_impl_find2(bw1, bw1_count, utf32_prev2, utf32_prev1) +
-                  hcbudoux_impl_find2(bw2, bw2_count, utf32_prev1, utf32_current) +
-                  hcbudoux_impl_find2(bw3, bw3_count, utf32_current, utf32_next1) +
-                  hcbudoux_impl_find3(tw1, tw1_count, utf32_prev3, utf32_prev2, utf32_prev1) +
-                  hcbudoux_impl_find3(tw2, tw2_count, utf32_prev2, utf32_prev1, utf32_current) +
-                  hcbudoux_impl_find3(tw3, tw3_count, utf32_prev1, utf32_current, utf32_next1) +
-                  hcbudoux_impl_find3(tw4, tw4_count, utf32_current, utf32_next1, utf32_next2);
-  return base_score + 2 * sum;
+  return *base == x ? (int)(base - keys) : count;
+#endif
+}
+#endif
+
+// Returns ID of the character x.  Returns table->count (the unknown character) if x is not found.
+static int hcbudoux_impl_find_unigram(const hcbudoux_impl_unigram_table *table, uint32_t x) {
+#if HCBUDOUX_IMPL_UNIGRAM_PAGE_TABLE
+  uint32_t const page = x >> 8;
+  uint32_t const last = (uint32_t)table->page_index_count - 1;
+  return table->pages[((uint32_t)table->page_index[page < last ? page : last] << 8) | (x & 0xff)];
+#elif HCBUDOUX_IMPL_PERFECT_HASH || HCBUDOUX_IMPL_EYTZINGER
+  int const i = hcbudoux_impl_find_key(table->keys, table->count, table->disp, table->disp_count, x);
+  return i < table->count ? table->ids[i] : table->count;
+#elif HCBUDOUX_IMPL_SWITCH
+  return table->find(x);
+#else
+  return hcbudoux_impl_find_key(table->keys, table->count, table->disp, table->disp_count, x);
+#endif
+}
+
+// Returns index of the record of x.  Returns table->count (the empty record) if x is not found.
+static int hcbudoux_impl_find_bigram(const hcbudoux_impl_bigram_table *table, uint32_t x) {
+#if HCBUDOUX_IMPL_SWITCH
+  return table->find(x);
+#else
+  return hcbudoux_impl_find_key(table->keys, table->count, table->disp, table->disp_count, x);
+#endif
+}
+
+static int hcbudoux_impl_find_trigram(const hcbudoux_impl_trigram_table *table, uint32_t x) {
+#if HCBUDOUX_IMPL_SWITCH
+  return table->find(x);
+#else
+  return hcbudoux_impl_find_key(table->keys, table->count, table->disp, table->disp_count, x);
+#endif
+}
+
+// Counts n-gram lookups.  bench.c defines it to measure the number of lookups.
+#if !defined(HCBUDOUX_IMPL_COUNT_LOOKUP)
+#define HCBUDOUX_IMPL_COUNT_LOOKUP() ((void)0)
+#endif
+
+// Returns index of the bigram record of the characters ids[0], ids[1].
+// The lookup is skipped when the characters don't participate in BW keys at their positions.  Since the unknown
+// character has the empty mask, it is always skipped.
+static int hcbudoux_impl_lookup_bigram(const hcbudoux_impl_tables *tables, const int *ids, const uint8_t *masks) {
+  uint32_t const radix = (uint32_t)tables->uw.count;
+  if (!(masks[0] & hcbudoux_impl_mask_bigram0) || !(masks[1] & hcbudoux_impl_mask_bigram1)) {
+    return tables->bw.count;
+  }
+  HCBUDOUX_IMPL_COUNT_LOOKUP();
+  return hcbudoux_impl_find_bigram(&tables->bw, (uint32_t)ids[0] * radix + (uint32_t)ids[1]);
+}
+
+// Returns index of the trigram record of the characters ids[0], ..., ids[2].
+// The lookup is skipped when the characters don't participate in TW keys at their positions.
+static int hcbudoux_impl_lookup_trigram(const hcbudoux_impl_tables *tables, const int *ids, const uint8_t *masks) {
+  uint32_t const radix = (uint32_t)tables->uw.count;
+  if (!(masks[0] & hcbudoux_impl_mask_trigram0) || !(masks[1] & hcbudoux_impl_mask_trigram1) ||
+      !(masks[2] & hcbudoux_impl_mask_trigram2)) {
+    return tables->tw.count;
+  }
+  HCBUDOUX_IMPL_COUNT_LOOKUP();
+  return hcbudoux_impl_find_trigram(&tables->tw,
+                                    ((uint32_t)ids[0] * radix + (uint32_t)ids[1]) * radix + (uint32_t)ids[2]);
 }
 
 //
 // BudouX Models
 //
 #if defined(HCBUDOUX_USE_JA) && (HCBUDOUX_USE_JA)
-static int hcbudoux_impl_compute_score_ja(uint32_t utf32_prev3, uint32_t utf32_prev2, uint32_t utf32_prev1,
-                                          uint32_t utf32_current, uint32_t utf32_next1, uint32_t utf32_next2) {
-  static hcbudoux_impl_item1 const uw1[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW1)};
-  static hcbudoux_impl_item1 const uw2[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW2)};
-  static hcbudoux_impl_item1 const uw3[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW3)};
-  static hcbudoux_impl_item1 const uw4[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW4)};
-  static hcbudoux_impl_item1 const uw5[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW5)};
-  static hcbudoux_impl_item1 const uw6[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW6)};
-  static hcbudoux_impl_item2 const bw1[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.BW1)};
-  static hcbudoux_impl_item2 const bw2[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.BW2)};
-  static hcbudoux_impl_item2 const bw3[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.BW3)};
-  static hcbudoux_impl_item3 const tw1[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.TW1)};
-  static hcbudoux_impl_item3 const tw2[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.TW2)};
-  static hcbudoux_impl_item3 const tw3[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.TW3)};
-  static hcbudoux_impl_item3 const tw4[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.TW4)};
-  static int const base = HCBUDOUX_IMPL_TEMPLATE(_ja_.Base);
-  return hcbudoux_impl_compute_score_from_tables(
-      base, uw1, (int)(sizeof(uw1) / sizeof(uw1[0])), uw2, (int)(sizeof(uw2) / sizeof(uw2[0])), uw3,
-      (int)(sizeof(uw3) / sizeof(uw3[0])), uw4, (int)(sizeof(uw4) / sizeof(uw4[0])), uw5,
-      (int)(sizeof(uw5) / sizeof(uw5[0])), uw6, (int)(sizeof(uw6) / sizeof(uw6[0])), bw1,
-      (int)(sizeof(bw1) / sizeof(bw1[0])), bw2, (int)(sizeof(bw2) / sizeof(bw2[0])), bw3,
-      (int)(sizeof(bw3) / sizeof(bw3[0])), tw1, (int)(sizeof(tw1) / sizeof(tw1[0])), tw2,
-      (int)(sizeof(tw2) / sizeof(tw2[0])), tw3, (int)(sizeof(tw3) / sizeof(tw3[0])), tw4,
-      (int)(sizeof(tw4) / sizeof(tw4[0])), utf32_prev3, utf32_prev2, utf32_prev1, utf32_current, utf32_next1,
-      utf32_next2);
+#if HCBUDOUX_IMPL_SWITCH
+static int hcbudoux_impl_switch_ja_uw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.Count);
+  }
+}
+
+static int hcbudoux_impl_switch_ja_bw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_ja_.BW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_ja_.BW.Count);
+  }
+}
+
+static int hcbudoux_impl_switch_ja_tw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_ja_.TW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_ja_.TW.Count);
+  }
+}
+#endif
+
+static const hcbudoux_impl_tables *hcbudoux_impl_tables_ja(void) {
+#if HCBUDOUX_IMPL_UNIGRAM_PAGE_TABLE
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.Keys)};
+  static uint8_t const uw_page_index[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.PageIndex)};
+  static uint16_t const uw_pages[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.Pages)};
+#elif HCBUDOUX_IMPL_PERFECT_HASH
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.PerfectHash.Keys)};
+  static uint16_t const uw_ids[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.PerfectHash.Ids)};
+  static uint16_t const uw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.PerfectHashDisp)};
+#elif HCBUDOUX_IMPL_EYTZINGER
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.Eytzinger.Keys)};
+  static uint16_t const uw_ids[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.Eytzinger.Ids)};
+#else
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.Keys)};
+#endif
+  static hcbudoux_impl_unigram const uw[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint8_t const uw_masks[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.Masks) 0};
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+  static hcbudoux_impl_unigram_bound const uw_bounds[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.UW.Bounds){0, 0, 0, 0}};
+#endif
+#if HCBUDOUX_IMPL_PERFECT_HASH
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.BW.PerfectHash.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_ja_.BW.PerfectHash.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.TW.PerfectHash.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_ja_.TW.PerfectHash.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint16_t const bw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.BW.PerfectHashDisp)};
+  static uint16_t const tw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.TW.PerfectHashDisp)};
+#elif HCBUDOUX_IMPL_EYTZINGER
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.BW.Eytzinger.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_ja_.BW.Eytzinger.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.TW.Eytzinger.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_ja_.TW.Eytzinger.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+#else
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.BW.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.BW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.TW.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_.TW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+#endif
+  static hcbudoux_impl_tables const tables = {
+      HCBUDOUX_IMPL_TEMPLATE(_ja_.Base),
+      HCBUDOUX_IMPL_UNIGRAM_TABLE(ja, uw),
+      HCBUDOUX_IMPL_TABLE(ja, bw),
+      HCBUDOUX_IMPL_TABLE(ja, tw),
+  };
+  return &tables;
 }
 #endif
 
 #if defined(HCBUDOUX_USE_JA_KNBC) && (HCBUDOUX_USE_JA_KNBC)
-static int hcbudoux_impl_compute_score_ja_knbc(uint32_t utf32_prev3, uint32_t utf32_prev2, uint32_t utf32_prev1,
-                                               uint32_t utf32_current, uint32_t utf32_next1, uint32_t utf32_next2) {
-  static hcbudoux_impl_item1 const uw1[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW1)};
-  static hcbudoux_impl_item1 const uw2[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW2)};
-  static hcbudoux_impl_item1 const uw3[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW3)};
-  static hcbudoux_impl_item1 const uw4[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW4)};
-  static hcbudoux_impl_item1 const uw5[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW5)};
-  static hcbudoux_impl_item1 const uw6[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW6)};
-  static hcbudoux_impl_item2 const bw1[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW1)};
-  static hcbudoux_impl_item2 const bw2[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW2)};
-  static hcbudoux_impl_item2 const bw3[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW3)};
-  static hcbudoux_impl_item3 const tw1[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW1)};
-  static hcbudoux_impl_item3 const tw2[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW2)};
-  static hcbudoux_impl_item3 const tw3[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW3)};
-  static hcbudoux_impl_item3 const tw4[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW4)};
-  static int const base = HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.Base);
-  return hcbudoux_impl_compute_score_from_tables(
-      base, uw1, (int)(sizeof(uw1) / sizeof(uw1[0])), uw2, (int)(sizeof(uw2) / sizeof(uw2[0])), uw3,
-      (int)(sizeof(uw3) / sizeof(uw3[0])), uw4, (int)(sizeof(uw4) / sizeof(uw4[0])), uw5,
-      (int)(sizeof(uw5) / sizeof(uw5[0])), uw6, (int)(sizeof(uw6) / sizeof(uw6[0])), bw1,
-      (int)(sizeof(bw1) / sizeof(bw1[0])), bw2, (int)(sizeof(bw2) / sizeof(bw2[0])), bw3,
-      (int)(sizeof(bw3) / sizeof(bw3[0])), tw1, (int)(sizeof(tw1) / sizeof(tw1[0])), tw2,
-      (int)(sizeof(tw2) / sizeof(tw2[0])), tw3, (int)(sizeof(tw3) / sizeof(tw3[0])), tw4,
-      (int)(sizeof(tw4) / sizeof(tw4[0])), utf32_prev3, utf32_prev2, utf32_prev1, utf32_current, utf32_next1,
-      utf32_next2);
+#if HCBUDOUX_IMPL_SWITCH
+static int hcbudoux_impl_switch_ja_knbc_uw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.Count);
+  }
+}
+
+static int hcbudoux_impl_switch_ja_knbc_bw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW.Count);
+  }
+}
+
+static int hcbudoux_impl_switch_ja_knbc_tw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW.Count);
+  }
+}
+#endif
+
+static const hcbudoux_impl_tables *hcbudoux_impl_tables_ja_knbc(void) {
+#if HCBUDOUX_IMPL_UNIGRAM_PAGE_TABLE
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.Keys)};
+  static uint8_t const uw_page_index[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.PageIndex)};
+  static uint16_t const uw_pages[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.Pages)};
+#elif HCBUDOUX_IMPL_PERFECT_HASH
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.PerfectHash.Keys)};
+  static uint16_t const uw_ids[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.PerfectHash.Ids)};
+  static uint16_t const uw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.PerfectHashDisp)};
+#elif HCBUDOUX_IMPL_EYTZINGER
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.Eytzinger.Keys)};
+  static uint16_t const uw_ids[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.Eytzinger.Ids)};
+#else
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.Keys)};
+#endif
+  static hcbudoux_impl_unigram const uw[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint8_t const uw_masks[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.Masks) 0};
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+  static hcbudoux_impl_unigram_bound const uw_bounds[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.UW.Bounds){0, 0, 0, 0}};
+#endif
+#if HCBUDOUX_IMPL_PERFECT_HASH
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW.PerfectHash.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW.PerfectHash.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW.PerfectHash.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW.PerfectHash.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint16_t const bw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW.PerfectHashDisp)};
+  static uint16_t const tw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW.PerfectHashDisp)};
+#elif HCBUDOUX_IMPL_EYTZINGER
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW.Eytzinger.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW.Eytzinger.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW.Eytzinger.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW.Eytzinger.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+#else
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.BW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.TW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+#endif
+  static hcbudoux_impl_tables const tables = {
+      HCBUDOUX_IMPL_TEMPLATE(_ja_knbc_.Base),
+      HCBUDOUX_IMPL_UNIGRAM_TABLE(ja_knbc, uw),
+      HCBUDOUX_IMPL_TABLE(ja_knbc, bw),
+      HCBUDOUX_IMPL_TABLE(ja_knbc, tw),
+  };
+  return &tables;
 }
 #endif
 
 #if defined(HCBUDOUX_USE_TH) && (HCBUDOUX_USE_TH)
-static int hcbudoux_impl_compute_score_th(uint32_t utf32_prev3, uint32_t utf32_prev2, uint32_t utf32_prev1,
-                                          uint32_t utf32_current, uint32_t utf32_next1, uint32_t utf32_next2) {
-  static hcbudoux_impl_item1 const uw1[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW1)};
-  static hcbudoux_impl_item1 const uw2[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW2)};
-  static hcbudoux_impl_item1 const uw3[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW3)};
-  static hcbudoux_impl_item1 const uw4[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW4)};
-  static hcbudoux_impl_item1 const uw5[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW5)};
-  static hcbudoux_impl_item1 const uw6[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW6)};
-  static hcbudoux_impl_item2 const bw1[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.BW1)};
-  static hcbudoux_impl_item2 const bw2[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.BW2)};
-  static hcbudoux_impl_item2 const bw3[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.BW3)};
-  static hcbudoux_impl_item3 const tw1[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.TW1)};
-  static hcbudoux_impl_item3 const tw2[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.TW2)};
-  static hcbudoux_impl_item3 const tw3[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.TW3)};
-  static hcbudoux_impl_item3 const tw4[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.TW4)};
-  static int const base = HCBUDOUX_IMPL_TEMPLATE(_th_.Base);
-  return hcbudoux_impl_compute_score_from_tables(
-      base, uw1, (int)(sizeof(uw1) / sizeof(uw1[0])), uw2, (int)(sizeof(uw2) / sizeof(uw2[0])), uw3,
-      (int)(sizeof(uw3) / sizeof(uw3[0])), uw4, (int)(sizeof(uw4) / sizeof(uw4[0])), uw5,
-      (int)(sizeof(uw5) / sizeof(uw5[0])), uw6, (int)(sizeof(uw6) / sizeof(uw6[0])), bw1,
-      (int)(sizeof(bw1) / sizeof(bw1[0])), bw2, (int)(sizeof(bw2) / sizeof(bw2[0])), bw3,
-      (int)(sizeof(bw3) / sizeof(bw3[0])), tw1, (int)(sizeof(tw1) / sizeof(tw1[0])), tw2,
-      (int)(sizeof(tw2) / sizeof(tw2[0])), tw3, (int)(sizeof(tw3) / sizeof(tw3[0])), tw4,
-      (int)(sizeof(tw4) / sizeof(tw4[0])), utf32_prev3, utf32_prev2, utf32_prev1, utf32_current, utf32_next1,
-      utf32_next2);
+#if HCBUDOUX_IMPL_SWITCH
+static int hcbudoux_impl_switch_th_uw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_th_.UW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_th_.UW.Count);
+  }
+}
+
+static int hcbudoux_impl_switch_th_bw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_th_.BW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_th_.BW.Count);
+  }
+}
+
+static int hcbudoux_impl_switch_th_tw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_th_.TW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_th_.TW.Count);
+  }
+}
+#endif
+
+static const hcbudoux_impl_tables *hcbudoux_impl_tables_th(void) {
+#if HCBUDOUX_IMPL_UNIGRAM_PAGE_TABLE
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.Keys)};
+  static uint8_t const uw_page_index[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.PageIndex)};
+  static uint16_t const uw_pages[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.Pages)};
+#elif HCBUDOUX_IMPL_PERFECT_HASH
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.PerfectHash.Keys)};
+  static uint16_t const uw_ids[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.PerfectHash.Ids)};
+  static uint16_t const uw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.PerfectHashDisp)};
+#elif HCBUDOUX_IMPL_EYTZINGER
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.Eytzinger.Keys)};
+  static uint16_t const uw_ids[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.Eytzinger.Ids)};
+#else
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.Keys)};
+#endif
+  static hcbudoux_impl_unigram const uw[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint8_t const uw_masks[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.Masks) 0};
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+  static hcbudoux_impl_unigram_bound const uw_bounds[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.UW.Bounds){0, 0, 0, 0}};
+#endif
+#if HCBUDOUX_IMPL_PERFECT_HASH
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.BW.PerfectHash.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_th_.BW.PerfectHash.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.TW.PerfectHash.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_th_.TW.PerfectHash.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint16_t const bw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.BW.PerfectHashDisp)};
+  static uint16_t const tw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.TW.PerfectHashDisp)};
+#elif HCBUDOUX_IMPL_EYTZINGER
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.BW.Eytzinger.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_th_.BW.Eytzinger.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.TW.Eytzinger.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_th_.TW.Eytzinger.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+#else
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.BW.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.BW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.TW.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {HCBUDOUX_IMPL_TEMPLATE(_th_.TW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+#endif
+  static hcbudoux_impl_tables const tables = {
+      HCBUDOUX_IMPL_TEMPLATE(_th_.Base),
+      HCBUDOUX_IMPL_UNIGRAM_TABLE(th, uw),
+      HCBUDOUX_IMPL_TABLE(th, bw),
+      HCBUDOUX_IMPL_TABLE(th, tw),
+  };
+  return &tables;
 }
 #endif
 
 #if defined(HCBUDOUX_USE_ZH_HANS) && (HCBUDOUX_USE_ZH_HANS)
-static int hcbudoux_impl_compute_score_zh_hans(uint32_t utf32_prev3, uint32_t utf32_prev2, uint32_t utf32_prev1,
-                                               uint32_t utf32_current, uint32_t utf32_next1, uint32_t utf32_next2) {
-  static hcbudoux_impl_item1 const uw1[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW1)};
-  static hcbudoux_impl_item1 const uw2[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW2)};
-  static hcbudoux_impl_item1 const uw3[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW3)};
-  static hcbudoux_impl_item1 const uw4[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW4)};
-  static hcbudoux_impl_item1 const uw5[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW5)};
-  static hcbudoux_impl_item1 const uw6[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW6)};
-  static hcbudoux_impl_item2 const bw1[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW1)};
-  static hcbudoux_impl_item2 const bw2[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW2)};
-  static hcbudoux_impl_item2 const bw3[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW3)};
-  static hcbudoux_impl_item3 const tw1[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW1)};
-  static hcbudoux_impl_item3 const tw2[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW2)};
-  static hcbudoux_impl_item3 const tw3[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW3)};
-  static hcbudoux_impl_item3 const tw4[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW4)};
-  static int const base = HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.Base);
-  return hcbudoux_impl_compute_score_from_tables(
-      base, uw1, (int)(sizeof(uw1) / sizeof(uw1[0])), uw2, (int)(sizeof(uw2) / sizeof(uw2[0])), uw3,
-      (int)(sizeof(uw3) / sizeof(uw3[0])), uw4, (int)(sizeof(uw4) / sizeof(uw4[0])), uw5,
-      (int)(sizeof(uw5) / sizeof(uw5[0])), uw6, (int)(sizeof(uw6) / sizeof(uw6[0])), bw1,
-      (int)(sizeof(bw1) / sizeof(bw1[0])), bw2, (int)(sizeof(bw2) / sizeof(bw2[0])), bw3,
-      (int)(sizeof(bw3) / sizeof(bw3[0])), tw1, (int)(sizeof(tw1) / sizeof(tw1[0])), tw2,
-      (int)(sizeof(tw2) / sizeof(tw2[0])), tw3, (int)(sizeof(tw3) / sizeof(tw3[0])), tw4,
-      (int)(sizeof(tw4) / sizeof(tw4[0])), utf32_prev3, utf32_prev2, utf32_prev1, utf32_current, utf32_next1,
-      utf32_next2);
+#if HCBUDOUX_IMPL_SWITCH
+static int hcbudoux_impl_switch_zh_hans_uw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.Count);
+  }
+}
+
+static int hcbudoux_impl_switch_zh_hans_bw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW.Count);
+  }
+}
+
+static int hcbudoux_impl_switch_zh_hans_tw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW.Count);
+  }
+}
+#endif
+
+static const hcbudoux_impl_tables *hcbudoux_impl_tables_zh_hans(void) {
+#if HCBUDOUX_IMPL_UNIGRAM_PAGE_TABLE
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.Keys)};
+  static uint8_t const uw_page_index[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.PageIndex)};
+  static uint16_t const uw_pages[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.Pages)};
+#elif HCBUDOUX_IMPL_PERFECT_HASH
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.PerfectHash.Keys)};
+  static uint16_t const uw_ids[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.PerfectHash.Ids)};
+  static uint16_t const uw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.PerfectHashDisp)};
+#elif HCBUDOUX_IMPL_EYTZINGER
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.Eytzinger.Keys)};
+  static uint16_t const uw_ids[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.Eytzinger.Ids)};
+#else
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.Keys)};
+#endif
+  static hcbudoux_impl_unigram const uw[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint8_t const uw_masks[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.Masks) 0};
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+  static hcbudoux_impl_unigram_bound const uw_bounds[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.UW.Bounds){0, 0, 0, 0}};
+#endif
+#if HCBUDOUX_IMPL_PERFECT_HASH
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW.PerfectHash.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW.PerfectHash.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW.PerfectHash.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW.PerfectHash.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint16_t const bw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW.PerfectHashDisp)};
+  static uint16_t const tw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW.PerfectHashDisp)};
+#elif HCBUDOUX_IMPL_EYTZINGER
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW.Eytzinger.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW.Eytzinger.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW.Eytzinger.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW.Eytzinger.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+#else
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.BW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.TW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+#endif
+  static hcbudoux_impl_tables const tables = {
+      HCBUDOUX_IMPL_TEMPLATE(_zh_hans_.Base),
+      HCBUDOUX_IMPL_UNIGRAM_TABLE(zh_hans, uw),
+      HCBUDOUX_IMPL_TABLE(zh_hans, bw),
+      HCBUDOUX_IMPL_TABLE(zh_hans, tw),
+  };
+  return &tables;
 }
 #endif
 
 #if defined(HCBUDOUX_USE_ZH_HANT) && (HCBUDOUX_USE_ZH_HANT)
-static int hcbudoux_impl_compute_score_zh_hant(uint32_t utf32_prev3, uint32_t utf32_prev2, uint32_t utf32_prev1,
-                                               uint32_t utf32_current, uint32_t utf32_next1, uint32_t utf32_next2) {
-  static hcbudoux_impl_item1 const uw1[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW1)};
-  static hcbudoux_impl_item1 const uw2[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW2)};
-  static hcbudoux_impl_item1 const uw3[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW3)};
-  static hcbudoux_impl_item1 const uw4[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW4)};
-  static hcbudoux_impl_item1 const uw5[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW5)};
-  static hcbudoux_impl_item1 const uw6[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW6)};
-  static hcbudoux_impl_item2 const bw1[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW1)};
-  static hcbudoux_impl_item2 const bw2[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW2)};
-  static hcbudoux_impl_item2 const bw3[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW3)};
-  static hcbudoux_impl_item3 const tw1[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW1)};
-  static hcbudoux_impl_item3 const tw2[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW2)};
-  static hcbudoux_impl_item3 const tw3[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW3)};
-  static hcbudoux_impl_item3 const tw4[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW4)};
-  static int const base = HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.Base);
-  return hcbudoux_impl_compute_score_from_tables(
-      base, uw1, (int)(sizeof(uw1) / sizeof(uw1[0])), uw2, (int)(sizeof(uw2) / sizeof(uw2[0])), uw3,
-      (int)(sizeof(uw3) / sizeof(uw3[0])), uw4, (int)(sizeof(uw4) / sizeof(uw4[0])), uw5,
-      (int)(sizeof(uw5) / sizeof(uw5[0])), uw6, (int)(sizeof(uw6) / sizeof(uw6[0])), bw1,
-      (int)(sizeof(bw1) / sizeof(bw1[0])), bw2, (int)(sizeof(bw2) / sizeof(bw2[0])), bw3,
-      (int)(sizeof(bw3) / sizeof(bw3[0])), tw1, (int)(sizeof(tw1) / sizeof(tw1[0])), tw2,
-      (int)(sizeof(tw2) / sizeof(tw2[0])), tw3, (int)(sizeof(tw3) / sizeof(tw3[0])), tw4,
-      (int)(sizeof(tw4) / sizeof(tw4[0])), utf32_prev3, utf32_prev2, utf32_prev1, utf32_current, utf32_next1,
-      utf32_next2);
+#if HCBUDOUX_IMPL_SWITCH
+static int hcbudoux_impl_switch_zh_hant_uw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.Count);
+  }
+}
+
+static int hcbudoux_impl_switch_zh_hant_bw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW.Count);
+  }
+}
+
+static int hcbudoux_impl_switch_zh_hant_tw(uint32_t x) {
+  switch (x) {
+    HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW.Cases)
+    default:
+      return HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW.Count);
+  }
 }
 #endif
 
-//
-// Score computation
-//
-static int hcbudoux_impl_compute_score(hcbudoux_ctx *ctx, hcbudoux_impl_lang lang) {
-  uint32_t const u0 = ctx->impl.utf32s[0];
-  uint32_t const u1 = ctx->impl.utf32s[1];
-  uint32_t const u2 = ctx->impl.utf32s[2];
-  uint32_t const u3 = ctx->impl.utf32s[3];
-  uint32_t const u4 = ctx->impl.utf32s[4];
-  uint32_t const u5 = ctx->impl.utf32s[5];
+static const hcbudoux_impl_tables *hcbudoux_impl_tables_zh_hant(void) {
+#if HCBUDOUX_IMPL_UNIGRAM_PAGE_TABLE
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.Keys)};
+  static uint8_t const uw_page_index[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.PageIndex)};
+  static uint16_t const uw_pages[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.Pages)};
+#elif HCBUDOUX_IMPL_PERFECT_HASH
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.PerfectHash.Keys)};
+  static uint16_t const uw_ids[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.PerfectHash.Ids)};
+  static uint16_t const uw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.PerfectHashDisp)};
+#elif HCBUDOUX_IMPL_EYTZINGER
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.Eytzinger.Keys)};
+  static uint16_t const uw_ids[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.Eytzinger.Ids)};
+#else
+  static uint32_t const uw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.Keys)};
+#endif
+  static hcbudoux_impl_unigram const uw[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint8_t const uw_masks[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.Masks) 0};
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+  static hcbudoux_impl_unigram_bound const uw_bounds[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.UW.Bounds){0, 0, 0, 0}};
+#endif
+#if HCBUDOUX_IMPL_PERFECT_HASH
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW.PerfectHash.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW.PerfectHash.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW.PerfectHash.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW.PerfectHash.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint16_t const bw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW.PerfectHashDisp)};
+  static uint16_t const tw_disp[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW.PerfectHashDisp)};
+#elif HCBUDOUX_IMPL_EYTZINGER
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW.Eytzinger.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW.Eytzinger.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW.Eytzinger.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {
+      HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW.Eytzinger.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+#else
+  static uint32_t const bw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW.Keys)};
+  static hcbudoux_impl_bigram const bw[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.BW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+  static uint32_t const tw_keys[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW.Keys)};
+  static hcbudoux_impl_trigram const tw[] = {HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.TW.Scores) HCBUDOUX_IMPL_EMPTY_RECORD};
+#endif
+  static hcbudoux_impl_tables const tables = {
+      HCBUDOUX_IMPL_TEMPLATE(_zh_hant_.Base),
+      HCBUDOUX_IMPL_UNIGRAM_TABLE(zh_hant, uw),
+      HCBUDOUX_IMPL_TABLE(zh_hant, bw),
+      HCBUDOUX_IMPL_TABLE(zh_hant, tw),
+  };
+  return &tables;
+}
+#endif
 
+static const hcbudoux_impl_tables *hcbudoux_impl_get_tables(hcbudoux_impl_lang lang) {
   switch (lang) {
     case hcbudoux_impl_lang_ja:
 #if defined(HCBUDOUX_USE_JA) && (HCBUDOUX_USE_JA)
-      return hcbudoux_impl_compute_score_ja(u0, u1, u2, u3, u4, u5);
+      return hcbudoux_impl_tables_ja();
 #endif
       break;
     case hcbudoux_impl_lang_ja_knbc:
 #if defined(HCBUDOUX_USE_JA_KNBC) && (HCBUDOUX_USE_JA_KNBC)
-      return hcbudoux_impl_compute_score_ja_knbc(u0, u1, u2, u3, u4, u5);
+      return hcbudoux_impl_tables_ja_knbc();
 #endif
       break;
     case hcbudoux_impl_lang_th:
 #if defined(HCBUDOUX_USE_TH) && (HCBUDOUX_USE_TH)
-      return hcbudoux_impl_compute_score_th(u0, u1, u2, u3, u4, u5);
+      return hcbudoux_impl_tables_th();
 #endif
       break;
     case hcbudoux_impl_lang_zh_hans:
 #if defined(HCBUDOUX_USE_ZH_HANS) && (HCBUDOUX_USE_ZH_HANS)
-      return hcbudoux_impl_compute_score_zh_hans(u0, u1, u2, u3, u4, u5);
+      return hcbudoux_impl_tables_zh_hans();
 #endif
       break;
     case hcbudoux_impl_lang_zh_hant:
 #if defined(HCBUDOUX_USE_ZH_HANT) && (HCBUDOUX_USE_ZH_HANT)
-      return hcbudoux_impl_compute_score_zh_hant(u0, u1, u2, u3, u4, u5);
+      return hcbudoux_impl_tables_zh_hant();
 #endif
       break;
     default:
       break;
   }
-  return -1;
+  return 0;
 }
 
 //
-// Get next string view
+// UTF-8 decoder
 //
-static bool hcbudoux_impl_getnext(hcbudoux_ctx *ctx, hcbudoux_span *span, hcbudoux_impl_lang lang) {
-  for (;;) {
-    // Read a UTF-8 character
-    uint32_t new_utf32_char = 0;
-    int const new_utf32_char_index = ctx->impl.curr_index;
-    int new_utf32_char_size_in_bytes = 0;
-    {
-      int const rest = ctx->impl.utf8_str_size_in_bytes - new_utf32_char_index;
-
-      uint8_t const c0 = (uint8_t)(rest >= 1 ? (ctx->impl.utf8_str)[new_utf32_char_index + 0] : 0);
-      uint8_t const c1 = (uint8_t)(rest >= 2 ? (ctx->impl.utf8_str)[new_utf32_char_index + 1] : 0);
-      uint8_t const c2 = (uint8_t)(rest >= 3 ? (ctx->impl.utf8_str)[new_utf32_char_index + 2] : 0);
-      uint8_t const c3 = (uint8_t)(rest >= 4 ? (ctx->impl.utf8_str)[new_utf32_char_index + 3] : 0);
-
-      // https://en.wikipedia.org/wiki/UTF-8#Description
-      //      byte1
-      //      0yyyzzzz    1 byte      x & 0x80 == 0
-      //      110xxxyy    2 bytes     x & 0xe0 == 0xc0
-      //      1110wwww    3 bytes     x & 0xf0 == 0xe0
-      //      11110uvv    4 bytes     x & 0xf8 == 0xf0
-      if ((c0 & 0x80) == 0) {
-        if (rest >= 1) {
-          // c0
-          // 0yyyzzz
-          //
-          // |         |         |         |         |
-          // |0000 0000|0000 0000|0000 0000|0yyy zzzz|    [0x0000,0x007f]
-          uint32_t const p0 = c0 & 0x7f;
-          uint32_t const code_point = p0;
-          new_utf32_char = code_point;
-          new_utf32_char_size_in_bytes = 1;
-        }
-      } else if ((c0 & 0xe0) == 0xc0) {
-        if (rest >= 2) {
-          // c0       c1
-          // 110xxxyy 10yyzzzz
-          //
-          // |         |         |         |         |
-          // |0000 0000|0000 0000|0000 0xxx|yyyy zzzz|    [0x0080,0x07ff]
-          uint32_t const p0 = (c0 & 0x1f) << 6;
-          uint32_t const p1 = (c1 & 0x3f);
-          uint32_t const code_point = p0 | p1;
-          new_utf32_char = code_point;
-          new_utf32_char_size_in_bytes = 2;
-        }
-      } else if ((c0 & 0xf0) == 0xe0) {
-        if (rest >= 3) {
-          // c0       c1       c2
-          // 1110wwww 10xxxxyy 10yyzzzz
-          //
-          // |         |         |         |         |
-          // |0000 0000|0000 0000|wwww xxxx|yyyy zzzz|    [0x0800,0xffff]
-          uint32_t const p0 = (c0 & 0x0f) << 12;
-          uint32_t const p1 = (c1 & 0x3f) << 6;
-          uint32_t const p2 = (c2 & 0x3f);
-          uint32_t const code_point = p0 | p1 | p2;
-          new_utf32_char = code_point;
-          new_utf32_char_size_in_bytes = 3;
-        }
-      } else if ((c0 & 0xf8) == 0xf0) {
-        if (rest >= 4) {
-          // c0       c1       c2       c3
-          // 11110uvv 10vvwwww 10xxxxyy 10yyzzzz
-          //
-          // |         |         |         |         |
-          // |0000 0000|000u vvvv|wwww xxxx|yyyy zzzz|    [0x010000,0x01ffff]
-          uint32_t const p0 = (c0 & 0x07) << 18;
-          uint32_t const p1 = (c1 & 0x3f) << 12;
-          uint32_t const p2 = (c2 & 0x3f) << 6;
-          uint32_t const p3 = (c3 & 0x3f);
-          uint32_t const code_point = p0 | p1 | p2 | p3;
-          new_utf32_char = code_point;
-          new_utf32_char_size_in_bytes = 4;
-        }
-      }
-    }
+// Validating decoder with a DFA (see https://bjoern.hoehrmann.de/utf-8/decoder/dfa/).  A byte is mapped to its class
+// and the state moves with the class.  Ill-formed sequences are decoded as U+FFFD per maximal subpart: the lead byte
+// and the following bytes which may continue the sequence are replaced with one U+FFFD.  The decoder consumes at least
+// one byte unless it's at the end of the string, so the callers always make progress.
+enum {
+  hcbudoux_impl_utf8_accept = 0,
+  hcbudoux_impl_utf8_reject = 6,
+  hcbudoux_impl_utf8_class_count = 12,
+  hcbudoux_impl_replacement_char = 0xfffd,
+};
 
-    // Add new UTF32 character to the queue
-    ctx->impl.utf32s[0] = ctx->impl.utf32s[1];
-    ctx->impl.utf32s[1] = ctx->impl.utf32s[2];
-    ctx->impl.utf32s[2] = ctx->impl.utf32s[3];
-    ctx->impl.utf32s[3] = ctx->impl.utf32s[4];
-    ctx->impl.utf32s[4] = ctx->impl.utf32s[5];
-    ctx->impl.utf32s[5] = new_utf32_char;
+// Class of bytes.
+//   0 : 00-7f  1 : 80-8f  2 : 90-9f  3 : a0-bf  4 : c0-c1, f5-ff  5 : c2-df
+//   6 : e0     7 : e1-ec, ee-ef      8 : ed     9 : f0   10 : f1-f3  11 : f4
+static const uint8_t hcbudoux_impl_utf8_classes[256] = {
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 00-0f
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 10-1f
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 20-2f
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 30-3f
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 40-4f
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 50-5f
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 60-6f
+     0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  0,  // 70-7f
+     1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  1,  // 80-8f
+     2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  2,  // 90-9f
+     3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  // a0-af
+     3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  3,  // b0-bf
+     4,  4,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  // c0-cf
+     5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  5,  // d0-df
+     6,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  7,  8,  7,  7,  // e0-ef
+     9, 10, 10, 10, 11,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  4,  // f0-ff
+};
 
-    ctx->impl.indices[0] = ctx->impl.indices[1];
-    ctx->impl.indices[1] = ctx->impl.indices[2];
-    ctx->impl.indices[2] = ctx->impl.indices[3];
-    ctx->impl.indices[3] = ctx->impl.indices[4];
-    ctx->impl.indices[4] = ctx->impl.indices[5];
-    ctx->impl.indices[5] = new_utf32_char_index;
+// Transitions of [class].  A state is the offset of its next state in the row (6 bits per state), so the next state is
+// (transitions[class] >> state) & 0x3f.  The row is loaded from the byte only, and the state depends on a shift only.
+// States other than accept (0) and reject (6) wait for continuation bytes.
+//   12 : 1 byte   18 : 2 bytes   24 : a0-bf and 1 byte (after e0)   30 : 80-9f and 1 byte (after ed)
+//   36 : 3 bytes  42 : 90-bf and 2 bytes (after f0)                48 : 80-8f and 2 bytes (after f4)
+static const uint64_t hcbudoux_impl_utf8_transitions[hcbudoux_impl_utf8_class_count] = {
+    UINT64_C(0x0006186186186180), UINT64_C(0x0012192306300186), UINT64_C(0x0006492306300186),
+    UINT64_C(0x000649218c300186), UINT64_C(0x0006186186186186), UINT64_C(0x000618618618618c),
+    UINT64_C(0x0006186186186198), UINT64_C(0x0006186186186192), UINT64_C(0x000618618618619e),
+    UINT64_C(0x00061861861861aa), UINT64_C(0x00061861861861a4), UINT64_C(0x00061861861861b0),
+};
 
-    ctx->impl.curr_index += new_utf32_char_size_in_bytes;
+// Payload bits of the lead byte of [class].
+static const uint8_t hcbudoux_impl_utf8_lead_masks[hcbudoux_impl_utf8_class_count] = {
+    0x7f, 0, 0, 0, 0, 0x1f, 0x0f, 0x0f, 0x0f, 0x07, 0x07, 0x07,
+};
 
-    {
-      int const start = ctx->impl.last_index;
-      int const end = ctx->impl.indices[3];
-      int const length = end - start;
+// Returns the next state of the DFA.
+static uint32_t hcbudoux_impl_utf8_next_state(uint32_t state, uint8_t c) {
+  return (uint32_t)(hcbudoux_impl_utf8_transitions[hcbudoux_impl_utf8_classes[c]] >> state) & 0x3f;
+}
 
-      // utf32s[3] represents 0 offset (current) character.
-      if (ctx->impl.utf32s[3] != 0) {
-        // Queue contains valid input.
+// Decodes a non-ASCII character at utf8_str[index] with the DFA.  index must be in utf8_str.
+HCBUDOUX_IMPL_NOINLINE static uint32_t hcbudoux_impl_decode_utf8_dfa(const uint8_t *utf8_str,
+                                                                     int utf8_str_size_in_bytes, int index,
+                                                                     int *size_in_bytes) {
+  int const rest = utf8_str_size_in_bytes - index;
+  uint8_t const c0 = utf8_str[index];
+  uint32_t code_point = c0 & hcbudoux_impl_utf8_lead_masks[hcbudoux_impl_utf8_classes[c0]];
+  uint32_t state = hcbudoux_impl_utf8_next_state(hcbudoux_impl_utf8_accept, c0);
+  int size = 1;
+  while (state > hcbudoux_impl_utf8_reject && size < rest) {
+    uint8_t const c = utf8_str[index + size];
+    uint32_t const next = hcbudoux_impl_utf8_next_state(state, c);
+    if (next == hcbudoux_impl_utf8_reject) {
+      break;
+    }
+    code_point = (code_point << 6) | (c & 0x3fu);
+    state = next;
+    ++size;
+  }
 
-        // Evaluate queue
-        int const score = hcbudoux_impl_compute_score(ctx, lang);
+  *size_in_bytes = size;
+  return state == hcbudoux_impl_utf8_accept ? code_point : (uint32_t)hcbudoux_impl_replacement_char;
+}
 
-        // If score > 0, it means we can put &nbsp; between character at
-        // utf32s[2] and utf32s[3]. Also, since the first valid character may
-        // have positive score, we should avoid it (length <= 0).
-        if (score <= 0 || length <= 0) {
-          continue;
-        }
+// Decodes a UTF-8 character at utf8_str[index] and sets its size to *size_in_bytes.
+// Returns 0 and sets 0 to *size_in_bytes when index is at (or after) the end of utf8_str.
+// Returns U+FFFD for an ill-formed or truncated sequence.  *size_in_bytes is its maximal subpart (at least 1).
+static uint32_t hcbudoux_impl_decode_utf8(const uint8_t *utf8_str, int utf8_str_size_in_bytes, int index,
+                                          int *size_in_bytes) {
+  int const rest = utf8_str_size_in_bytes - index;
+  if (rest <= 0) {
+    *size_in_bytes = 0;
+    return 0;
+  }
 
-        span->offset = start;
-        span->length = length;
-        ctx->impl.last_index = end;
-        return true;  // true indicates valid span
-      } else if (ctx->impl.indices[3] >= ctx->impl.utf8_str_size_in_bytes) {
-        // Queue is empty. (index exceeded the last character)
+  // ASCII doesn't need the DFA.
+  uint8_t const c0 = utf8_str[index];
+  if (c0 < 0x80) {
+    *size_in_bytes = 1;
+    return c0;
+  }
 
-        if (length <= 0 || start >= ctx->impl.utf8_str_size_in_bytes) {
-          break;
-        }
+  // Well-formed 2 and 3 bytes sequences which have no special range of the second byte (lead byte c2-df, e1-ec and
+  // ee-ef) don't need the DFA either.  They are the most of non-ASCII text.
+  if (rest >= 2 && c0 >= 0xc2 && c0 < 0xe0) {
+    uint8_t const c1 = utf8_str[index + 1];
+    if ((c1 & 0xc0) == 0x80) {
+      *size_in_bytes = 2;
+      return ((c0 & 0x1fu) << 6) | (c1 & 0x3fu);
+    }
+  } else if (rest >= 3 && c0 >= 0xe1 && c0 < 0xf0 && c0 != 0xed) {
+    uint8_t const c1 = utf8_str[index + 1];
+    uint8_t const c2 = utf8_str[index + 2];
+    if ((c1 & 0xc0) == 0x80 && (c2 & 0xc0) == 0x80) {
+      *size_in_bytes = 3;
+      return ((c0 & 0x0fu) << 12) | ((c1 & 0x3fu) << 6) | (c2 & 0x3fu);
+    }
+  }
 
-        // If we have the last valid chunk, return it before entering EOF state.
-        if (length > 0 && start < ctx->impl.utf8_str_size_in_bytes) {
-          // Set EOF state for next time.  Make sure we won't process further.
-          span->offset = start;
-          span->length = length;
-          ctx->impl.curr_index = ctx->impl.utf8_str_size_in_bytes;
-          ctx->impl.last_index = ctx->impl.utf8_str_size_in_bytes;
-          return true;  // true indicates valid span
-        }
+  return hcbudoux_impl_decode_utf8_dfa(utf8_str, utf8_str_size_in_bytes, index, size_in_bytes);
+}
 
-        // There's nothing to do.  Return empty span.
-        break;
+// Decodes a UTF-8 character at utf8_str[index] of the string which is terminated with '\0'.
+// Returns 0 and sets 0 to *size_in_bytes at the terminator.
+// Since '\0' is not a continuation byte, a byte is loaded only when the previous byte is not '\0'.  So the decoder
+// doesn't need the size of the string and has no bounds checks.
+static uint32_t hcbudoux_impl_decode_utf8_nul(const uint8_t *utf8_str, int index, int *size_in_bytes) {
+  uint8_t const c0 = utf8_str[index];
+  if (c0 < 0x80) {
+    *size_in_bytes = c0 != 0;
+    return c0;
+  }
+  if (c0 >= 0xc2 && c0 < 0xe0) {
+    uint8_t const c1 = utf8_str[index + 1];
+    if ((c1 & 0xc0) == 0x80) {
+      *size_in_bytes = 2;
+      return ((c0 & 0x1fu) << 6) | (c1 & 0x3fu);
+    }
+  } else if (c0 >= 0xe1 && c0 < 0xf0 && c0 != 0xed) {
+    uint8_t const c1 = utf8_str[index + 1];
+    if ((c1 & 0xc0) == 0x80) {
+      uint8_t const c2 = utf8_str[index + 2];
+      if ((c2 & 0xc0) == 0x80) {
+        *size_in_bytes = 3;
+        return ((c0 & 0x0fu) << 12) | ((c1 & 0x3fu) << 6) | (c2 & 0x3fu);
       }
     }
   }
+  // The DFA rejects '\0' after any byte, so it stops at the terminator.
+  return hcbudoux_impl_decode_utf8_dfa(utf8_str, INT32_MAX, index, size_in_bytes);
+}
 
-  // Return empty span.
-  span->offset = 0;
-  span->length = 0;
-  return false;  // false indicates invalid span, end of string
+//
+// UTF-16 decoder
+//
+// Decodes a UTF-16 character at utf16_str[index] and sets its size in code units to *size_in_units.
+// Returns 0 and sets 0 to *size_in_units when index is at (or after) the end of utf16_str.
+// Returns U+FFFD for an unpaired surrogate (1 code unit).
+static uint32_t hcbudoux_impl_decode_utf16(const uint16_t *utf16_str, int utf16_str_size_in_units, int index,
+                                           int *size_in_units) {
+  if (index >= utf16_str_size_in_units) {
+    *size_in_units = 0;
+    return 0;
+  }
+  uint32_t const u0 = utf16_str[index];
+  if ((u0 & 0xf800) != 0xd800) {
+    *size_in_units = 1;
+    return u0;
+  }
+  // High surrogate (d800-dbff) followed by low surrogate (dc00-dfff).  A NUL-terminated string (INT32_MAX) has the
+  // next code unit since u0 is not 0.
+  if (u0 < 0xdc00 && index + 1 < utf16_str_size_in_units) {
+    uint32_t const u1 = utf16_str[index + 1];
+    if ((u1 & 0xfc00) == 0xdc00) {
+      *size_in_units = 2;
+      return 0x10000 + ((u0 - 0xd800) << 10) + (u1 - 0xdc00);
+    }
+  }
+  *size_in_units = 1;
+  return hcbudoux_impl_replacement_char;
 }
 
 //
-// Public API: Get next string view
+// UTF-32 decoder
 //
-#if defined(HCBUDOUX_USE_JA) && (HCBUDOUX_USE_JA)
-bool hcbudoux_getnext_ja(hcbudoux_ctx *ctx, hcbudoux_span *span) {
-  return hcbudoux_impl_getnext(ctx, span, hcbudoux_impl_lang_ja);
+// Returns the code point at utf32_str[index] and sets 1 to *size_in_units.  Surrogates and code points above U+10FFFF
+// are U+FFFD.  Returns 0 and sets 0 to *size_in_units when index is at (or after) the end of utf32_str.
+static uint32_t hcbudoux_impl_decode_utf32(const uint32_t *utf32_str, int utf32_str_length, int index,
+                                           int *size_in_units) {
+  if (index >= utf32_str_length) {
+    *size_in_units = 0;
+    return 0;
+  }
+  uint32_t const c = utf32_str[index];
+  *size_in_units = 1;
+  return c > 0x10ffff || (c & 0xfffff800) == 0xd800 ? (uint32_t)hcbudoux_impl_replacement_char : c;
 }
-#endif
+
+// Decodes up to count characters at utf8_str[*index] to utf32s[] and their offsets to indices[], and advances *index.
+// Returns the number of decoded characters, which is less than count only at the end of the string.
+//
+// The string is read in chunks of 32 (AVX2) or 16 (SSE2) bytes.  A chunk of ASCII is widened at once.  Otherwise the
+// continuation bytes of the chunk are classified at once, and well-formed 1, 2 and 3 bytes sequences (lead byte
+// 00-7f, c2-df, e1-ec and ee-ef) are decoded without bounds checks.  The other lead bytes, ill-formed sequences and
+// the tail of the string go to hcbudoux_impl_decode_utf8().
+HCBUDOUX_IMPL_MAYBE_UNUSED static int hcbudoux_impl_decode_utf8_block(const uint8_t *utf8_str,
+                                                                     int utf8_str_size_in_bytes, int *index, int count,
+                                                                     uint32_t *utf32s, int *indices) {
+  int n = 0;
+  int i = *index;
+#if HCBUDOUX_IMPL_AVX2 || HCBUDOUX_IMPL_SSE2
+#if HCBUDOUX_IMPL_AVX2
+  enum { chunk_size = 32 };
+#else
+  enum { chunk_size = 16 };
+#endif
+  while (n + chunk_size <= count && i + chunk_size <= utf8_str_size_in_bytes) {
+    const uint8_t *const chunk = &utf8_str[i];
+#if HCBUDOUX_IMPL_AVX2
+    __m256i const v = _mm256_loadu_si256((const __m256i *)(const void *)chunk);
+    uint32_t const non_ascii = (uint32_t)_mm256_movemask_epi8(v);
+    if (non_ascii == 0) {
+      __m256i const offsets = _mm256_add_epi32(_mm256_set1_epi32(i), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+      for (int k = 0; k < chunk_size; k += 8) {
+        __m256i const c = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i *)(const void *)&chunk[k]));
+        _mm256_storeu_si256((__m256i *)(void *)&utf32s[n + k], c);
+        _mm256_storeu_si256((__m256i *)(void *)&indices[n + k], _mm256_add_epi32(offsets, _mm256_set1_epi32(k)));
+      }
+      n += chunk_size;
+      i += chunk_size;
+      continue;
+    }
+    // Continuation bytes are 80-bf, that is less than -64 as int8_t.
+    uint32_t const cont = (uint32_t)_mm256_movemask_epi8(_mm256_cmpgt_epi8(_mm256_set1_epi8(-64), v));
+#else
+    __m128i const v = _mm_loadu_si128((const __m128i *)(const void *)chunk);
+    uint32_t const non_ascii = (uint32_t)_mm_movemask_epi8(v);
+    if (non_ascii == 0) {
+      __m128i const zero = _mm_setzero_si128();
+      __m128i const lo = _mm_unpacklo_epi8(v, zero);
+      __m128i const hi = _mm_unpackhi_epi8(v, zero);
+      __m128i const offsets = _mm_add_epi32(_mm_set1_epi32(i), _mm_setr_epi32(0, 1, 2, 3));
+      _mm_storeu_si128((__m128i *)(void *)&utf32s[n + 0], _mm_unpacklo_epi16(lo, zero));
+      _mm_storeu_si128((__m128i *)(void *)&utf32s[n + 4], _mm_unpackhi_epi16(lo, zero));
+      _mm_storeu_si128((__m128i *)(void *)&utf32s[n + 8], _mm_unpacklo_epi16(hi, zero));
+      _mm_storeu_si128((__m128i *)(void *)&utf32s[n + 12], _mm_unpackhi_epi16(hi, zero));
+      for (int k = 0; k < chunk_size; k += 4) {
+        _mm_storeu_si128((__m128i *)(void *)&indices[n + k], _mm_add_epi32(offsets, _mm_set1_epi32(k)));
+      }
+      n += chunk_size;
+      i += chunk_size;
+      continue;
+    }
+    // Continuation bytes are 80-bf, that is less than -64 as int8_t.
+    uint32_t const cont = (uint32_t)_mm_movemask_epi8(_mm_cmplt_epi8(v, _mm_set1_epi8(-64)));
+#endif
+
+    // Decode while the longest sequence (3 bytes) fits in the chunk.
+    int p = 0;
+    while (p <= chunk_size - 3) {
+      uint32_t const c0 = chunk[p];
+      uint32_t c = 0;
+      int size = 0;
+      if (c0 < 0x80) {
+        c = c0;
+        size = 1;
+      } else if (c0 >= 0xc2 && c0 < 0xe0 && ((cont >> (p + 1)) & 1) != 0) {
+        c = ((c0 & 0x1f) << 6) | (chunk[p + 1] & 0x3fu);
+        size = 2;
+      } else if (c0 >= 0xe1 && c0 < 0xf0 && c0 != 0xed && ((cont >> (p + 1)) & 3) == 3) {
+        c = ((c0 & 0x0f) << 12) | ((chunk[p + 1] & 0x3fu) << 6) | (chunk[p + 2] & 0x3fu);
+        size = 3;
+      } else {
+        break;
+      }
+      utf32s[n] = c;
+      indices[n] = i + p;
+      ++n;
+      p += size;
+    }
+    i += p;
+
+    // The character which stopped the chunk.  It's not at the end of the string.
+    if (p <= chunk_size - 3) {
+      int size = 0;
+      uint32_t const c = hcbudoux_impl_decode_utf8(utf8_str, utf8_str_size_in_bytes, i, &size);
+      utf32s[n] = c;
+      indices[n] = i;
+      ++n;
+      i += size;
+    }
+  }
+#endif
+
+  while (n < count) {
+    int size = 0;
+    uint32_t const c = hcbudoux_impl_decode_utf8(utf8_str, utf8_str_size_in_bytes, i, &size);
+    if (size == 0) {
+      break;
+    }
+    utf32s[n] = c;
+    indices[n] = i;
+    ++n;
+    i += size;
+  }
+  *index = i;
+  return n;
+}
+
+//
+// Score computation
+//
+// Computes the score of the window.  u[] and m[] are IDs and masks of the 6 characters, b[] and t[] are indices of the
+// bigram and trigram records.  See hcbudoux_ctx::impl for their layout.
+static int hcbudoux_impl_compute_score(const hcbudoux_impl_tables *tables, const int *u, const uint8_t *m, const int *b,
+                                       const int *t) {
+  const hcbudoux_impl_unigram *const uw = tables->uw.items;
+  const hcbudoux_impl_bigram *const bw = tables->bw.items;
+  const hcbudoux_impl_trigram *const tw = tables->tw.items;
+
+  // The window which has no character of the model has no score.
+  if ((m[0] | m[1] | m[2] | m[3] | m[4] | m[5]) == 0) {
+    return tables->base_score;
+  }
+
+  int const sum = uw[u[0]].scores[0] + uw[u[1]].scores[1] + uw[u[2]].scores[2] + uw[u[3]].scores[3] +
+                  uw[u[4]].scores[4] + uw[u[5]].scores[5] + bw[b[0]].scores[0] + bw[b[1]].scores[1] +
+                  bw[b[2]].scores[2] + tw[t[0]].scores[0] + tw[t[1]].scores[1] + tw[t[2]].scores[2] +
+                  tw[t[3]].scores[3];
+  return tables->base_score + 2 * sum;
+}
+
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+// Returns true when the score of the window is positive.  It is the same as hcbudoux_impl_compute_score() > 0, but
+// n-gram records are looked up lazily: negative b[i] or t[i] is looked up and stored only when it is needed.
+//
+// Each n-gram score is bounded by the bounds of its characters.  When the unigram scores and the sums of the bounds
+// decide the sign of the score, it returns without n-gram lookups.
+static bool hcbudoux_impl_is_positive(const hcbudoux_impl_tables *tables, const int *u, const uint8_t *m, int *b,
+                                      int *t) {
+  const hcbudoux_impl_unigram *const uw = tables->uw.items;
+  const hcbudoux_impl_unigram_bound *const ub = tables->uw.bounds;
+  const hcbudoux_impl_bigram *const bw = tables->bw.items;
+  const hcbudoux_impl_trigram *const tw = tables->tw.items;
+  int const base_score = tables->base_score;
+
+  if ((m[0] | m[1] | m[2] | m[3] | m[4] | m[5]) == 0) {
+    return base_score > 0;
+  }
+
+  int sum = uw[u[0]].scores[0] + uw[u[1]].scores[1] + uw[u[2]].scores[2] + uw[u[3]].scores[3] + uw[u[4]].scores[4] +
+            uw[u[5]].scores[5];
+  int max = 0;
+  int min = 0;
+  for (int j = 0; j < 3; ++j) {
+    bool const in = (m[j + 1] & hcbudoux_impl_mask_bigram0) && (m[j + 2] & hcbudoux_impl_mask_bigram1);
+    int const max0 = ub[u[j + 1]].bigram_max;
+    int const max1 = ub[u[j + 2]].bigram_max;
+    int const min0 = ub[u[j + 1]].bigram_min;
+    int const min1 = ub[u[j + 2]].bigram_min;
+    max += in ? (max0 < max1 ? max0 : max1) : 0;
+    min += in ? (min0 > min1 ? min0 : min1) : 0;
+  }
+  for (int j = 0; j < 4; ++j) {
+    bool const in = (m[j] & hcbudoux_impl_mask_trigram0) && (m[j + 1] & hcbudoux_impl_mask_trigram1) &&
+                    (m[j + 2] & hcbudoux_impl_mask_trigram2);
+    int const max0 = ub[u[j]].trigram_max;
+    int const max1 = ub[u[j + 1]].trigram_max;
+    int const max2 = ub[u[j + 2]].trigram_max;
+    int const min0 = ub[u[j]].trigram_min;
+    int const min1 = ub[u[j + 1]].trigram_min;
+    int const min2 = ub[u[j + 2]].trigram_min;
+    int const max01 = max0 < max1 ? max0 : max1;
+    int const min01 = min0 > min1 ? min0 : min1;
+    max += in ? (max01 < max2 ? max01 : max2) : 0;
+    min += in ? (min01 > min2 ? min01 : min2) : 0;
+  }
+  if (base_score + 2 * (sum + min) > 0) {
+    return true;
+  }
+  if (base_score + 2 * (sum + max) <= 0) {
+    return false;
+  }
+
+  for (int j = 0; j < 3; ++j) {
+    if (b[j] < 0) {
+      b[j] = hcbudoux_impl_lookup_bigram(tables, &u[j + 1], &m[j + 1]);
+    }
+    sum += bw[b[j]].scores[j];
+  }
+  for (int j = 0; j < 4; ++j) {
+    if (t[j] < 0) {
+      t[j] = hcbudoux_impl_lookup_trigram(tables, &u[j], &m[j]);
+    }
+    sum += tw[t[j]].scores[j];
+  }
+  return base_score + 2 * sum > 0;
+}
+#endif
+
+//
+// Block segmentation
+//
+// These functions are internal API for bulk segmentation.  hcbudoux_getnext_*() don't use them.
+//
+enum { hcbudoux_impl_block_size = 64 };
+
+// Returns the number of trailing zero bits of x.  x must not be 0.
+HCBUDOUX_IMPL_MAYBE_UNUSED static int hcbudoux_impl_ctz64(uint64_t x) {
+#if defined(__GNUC__) || defined(__clang__)
+  return __builtin_ctzll(x);
+#else
+  int n = 0;
+  for (; !(x & 1); x >>= 1) {
+    ++n;
+  }
+  return n;
+#endif
+}
+
+// Block of characters for bulk segmentation.
+// The block has the last 5 characters of the previous block followed by hcbudoux_impl_block_size new characters.
+// Position i of the block is the window utf32s[i], ..., utf32s[i + 5] and its current character is utf32s[i + 3].
+// Each window has the same layout as hcbudoux_ctx::impl.  For example, the bigram records of position i are
+// bigrams[i], ..., bigrams[i + 2].
+//
+// The sequence of characters is the same as hcbudoux_impl_getnext(): it begins with zeros at index 0 and decoded
+// characters follow.  When there's no more character, it continues with zeros at the last index.
+typedef struct hcbudoux_impl_block {
+  const hcbudoux_impl_tables *tables;
+  const uint8_t *utf8_str;
+  int utf8_str_size_in_bytes;
+  int curr_index;  // Index of the next character to decode
+  int count;       // Number of characters which are decoded into this block
+  uint32_t utf32s[hcbudoux_impl_block_size + 5];
+  int indices[hcbudoux_impl_block_size + 5];
+  int unigrams[hcbudoux_impl_block_size + 5];
+  uint8_t masks[hcbudoux_impl_block_size + 5];
+  int bigrams[hcbudoux_impl_block_size + 3];
+  int trigrams[hcbudoux_impl_block_size + 3];
+} hcbudoux_impl_block;
+
+HCBUDOUX_IMPL_MAYBE_UNUSED static void hcbudoux_impl_init_block(hcbudoux_impl_block *block,
+                                                                const hcbudoux_impl_tables *tables,
+                                                                const void *utf8_str, int utf8_str_size_in_bytes) {
+  block->tables = tables;
+  block->utf8_str = (const uint8_t *)utf8_str;
+  block->utf8_str_size_in_bytes = utf8_str_size_in_bytes;
+  block->curr_index = 0;
+  block->count = hcbudoux_impl_block_size;
+  for (int i = 0; i < hcbudoux_impl_block_size + 5; ++i) {
+    block->utf32s[i] = 0;
+    block->indices[i] = 0;
+    block->unigrams[i] = hcbudoux_impl_find_unigram(&tables->uw, 0);
+    block->masks[i] = tables->uw.masks[block->unigrams[i]];
+  }
+  for (int i = 0; i < hcbudoux_impl_block_size + 3; ++i) {
+    block->bigrams[i] = hcbudoux_impl_lookup_bigram(tables, &block->unigrams[i + 1], &block->masks[i + 1]);
+    block->trigrams[i] = hcbudoux_impl_lookup_trigram(tables, &block->unigrams[i], &block->masks[i]);
+  }
+}
+
+// Decodes the next hcbudoux_impl_block_size characters and looks up their records.
+// Returns false when the previous block has scored all characters.
+HCBUDOUX_IMPL_MAYBE_UNUSED static bool hcbudoux_impl_fill_block(hcbudoux_impl_block *block) {
+  const hcbudoux_impl_tables *const tables = block->tables;
+  int const n = hcbudoux_impl_block_size;
+
+  // Position count + 1 of the previous block is the last decoded character.
+  if (block->count < n - 1) {
+    return false;
+  }
+
+  for (int i = 0; i < 5; ++i) {
+    block->utf32s[i] = block->utf32s[n + i];
+    block->indices[i] = block->indices[n + i];
+    block->unigrams[i] = block->unigrams[n + i];
+    block->masks[i] = block->masks[n + i];
+  }
+  for (int i = 0; i < 3; ++i) {
+    block->bigrams[i] = block->bigrams[n + i];
+    block->trigrams[i] = block->trigrams[n + i];
+  }
+
+  // When there's no more character, the rest of the block is zeros at the last index.
+  block->count = hcbudoux_impl_decode_utf8_block(block->utf8_str, block->utf8_str_size_in_bytes, &block->curr_index, n,
+                                                 &block->utf32s[5], &block->indices[5]);
+  for (int i = 5 + block->count; i < n + 5; ++i) {
+    block->utf32s[i] = 0;
+    block->indices[i] = block->curr_index;
+  }
+  for (int i = 5; i < n + 5; ++i) {
+    block->unigrams[i] = hcbudoux_impl_find_unigram(&tables->uw, block->utf32s[i]);
+    block->masks[i] = tables->uw.masks[block->unigrams[i]];
+  }
+  for (int i = 3; i < n + 3; ++i) {
+    block->bigrams[i] = hcbudoux_impl_lookup_bigram(tables, &block->unigrams[i + 1], &block->masks[i + 1]);
+    block->trigrams[i] = hcbudoux_impl_lookup_trigram(tables, &block->unigrams[i], &block->masks[i]);
+  }
+  return true;
+}
+
+// Returns boundaries of the block.  Bit i is set when hcbudoux_impl_getnext() breaks before the current character of
+// position i: the score is positive, the character is not 0 and it is not the first character of the string.
+HCBUDOUX_IMPL_MAYBE_UNUSED static uint64_t hcbudoux_impl_score_block_scalar(const hcbudoux_impl_block *block) {
+  const hcbudoux_impl_tables *const tables = block->tables;
+  uint64_t boundaries = 0;
+  for (int i = 0; i < hcbudoux_impl_block_size; ++i) {
+    int const score = hcbudoux_impl_compute_score(tables, &block->unigrams[i], &block->masks[i], &block->bigrams[i],
+                                                  &block->trigrams[i]);
+    bool const boundary = score > 0 && block->utf32s[i + 3] != 0 && block->indices[i + 3] > 0;
+    boundaries |= (uint64_t)boundary << i;
+  }
+  return boundaries;
+}
+
+#if HCBUDOUX_IMPL_DISPATCH
+// Gathers scores[j] of 8 records.  Since gather loads 32 bits, scores[j] is loaded with its neighbor in the record:
+// scores[0], scores[1] for j == 0 (lower half), scores[j - 1], scores[j] for j > 0 (upper half).
+HCBUDOUX_IMPL_TARGET("avx2")
+static __m256i hcbudoux_impl_gather_scores_avx2(const void *records, int record_size, const int *indices, int j) {
+  __m256i const index = _mm256_loadu_si256((const __m256i *)(const void *)indices);
+  __m256i const offset = _mm256_add_epi32(_mm256_mullo_epi32(index, _mm256_set1_epi32(record_size)),
+                                          _mm256_set1_epi32(j > 0 ? j * 2 - 2 : 0));
+  __m256i const v = _mm256_i32gather_epi32((const int *)records, offset, 1);
+  return j > 0 ? _mm256_srai_epi32(v, 16) : _mm256_srai_epi32(_mm256_slli_epi32(v, 16), 16);
+}
+
+// Same as hcbudoux_impl_score_block_scalar().  Scores 8 positions at once.
+HCBUDOUX_IMPL_TARGET("avx2")
+static uint64_t hcbudoux_impl_score_block_avx2(const hcbudoux_impl_block *block) {
+  const hcbudoux_impl_tables *const tables = block->tables;
+  int const uw_size = (int)sizeof(tables->uw.items[0]);
+  int const bw_size = (int)sizeof(tables->bw.items[0]);
+  int const tw_size = (int)sizeof(tables->tw.items[0]);
+  __m256i const zero = _mm256_setzero_si256();
+  uint64_t boundaries = 0;
+  for (int i = 0; i < hcbudoux_impl_block_size; i += 8) {
+    __m256i sum = zero;
+    for (int j = 0; j < 6; ++j) {
+      __m256i const v = hcbudoux_impl_gather_scores_avx2(tables->uw.items, uw_size, &block->unigrams[i + j], j);
+      sum = _mm256_add_epi32(sum, v);
+    }
+    for (int j = 0; j < 3; ++j) {
+      __m256i const v = hcbudoux_impl_gather_scores_avx2(tables->bw.items, bw_size, &block->bigrams[i + j], j);
+      sum = _mm256_add_epi32(sum, v);
+    }
+    for (int j = 0; j < 4; ++j) {
+      __m256i const v = hcbudoux_impl_gather_scores_avx2(tables->tw.items, tw_size, &block->trigrams[i + j], j);
+      sum = _mm256_add_epi32(sum, v);
+    }
+    __m256i const score = _mm256_add_epi32(_mm256_set1_epi32(tables->base_score), _mm256_add_epi32(sum, sum));
+    __m256i const utf32s = _mm256_loadu_si256((const __m256i *)(const void *)&block->utf32s[i + 3]);
+    __m256i const indices = _mm256_loadu_si256((const __m256i *)(const void *)&block->indices[i + 3]);
+    __m256i const boundary = _mm256_andnot_si256(
+        _mm256_cmpeq_epi32(utf32s, zero),
+        _mm256_and_si256(_mm256_cmpgt_epi32(score, zero), _mm256_cmpgt_epi32(indices, zero)));
+    boundaries |= (uint64_t)(uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(boundary)) << i;
+  }
+  return boundaries;
+}
+
+// GCC's AVX-512 intrinsics initialize their undefined source by itself, which -Wuninitialized reports in C++.
+#if defined(__GNUC__) && !defined(__clang__) && defined(__cplusplus)
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+// Same as hcbudoux_impl_gather_scores_avx2().  Gathers scores[j] of 16 records.
+HCBUDOUX_IMPL_TARGET("avx512f")
+static __m512i hcbudoux_impl_gather_scores_avx512(const void *records, int record_size, const int *indices, int j) {
+  __m512i const index = _mm512_loadu_si512((const void *)indices);
+  __m512i const offset = _mm512_add_epi32(_mm512_mullo_epi32(index, _mm512_set1_epi32(record_size)),
+                                          _mm512_set1_epi32(j > 0 ? j * 2 - 2 : 0));
+  __m512i const v = _mm512_i32gather_epi32(offset, records, 1);
+  return j > 0 ? _mm512_srai_epi32(v, 16) : _mm512_srai_epi32(_mm512_slli_epi32(v, 16), 16);
+}
+
+// Same as hcbudoux_impl_score_block_scalar().  Scores 16 positions at once.
+HCBUDOUX_IMPL_TARGET("avx512f")
+static uint64_t hcbudoux_impl_score_block_avx512(const hcbudoux_impl_block *block) {
+  const hcbudoux_impl_tables *const tables = block->tables;
+  int const uw_size = (int)sizeof(tables->uw.items[0]);
+  int const bw_size = (int)sizeof(tables->bw.items[0]);
+  int const tw_size = (int)sizeof(tables->tw.items[0]);
+  __m512i const zero = _mm512_setzero_si512();
+  uint64_t boundaries = 0;
+  for (int i = 0; i < hcbudoux_impl_block_size; i += 16) {
+    __m512i sum = zero;
+    for (int j = 0; j < 6; ++j) {
+      __m512i const v = hcbudoux_impl_gather_scores_avx512(tables->uw.items, uw_size, &block->unigrams[i + j], j);
+      sum = _mm512_add_epi32(sum, v);
+    }
+    for (int j = 0; j < 3; ++j) {
+      __m512i const v = hcbudoux_impl_gather_scores_avx512(tables->bw.items, bw_size, &block->bigrams[i + j], j);
+      sum = _mm512_add_epi32(sum, v);
+    }
+    for (int j = 0; j < 4; ++j) {
+      __m512i const v = hcbudoux_impl_gather_scores_avx512(tables->tw.items, tw_size, &block->trigrams[i + j], j);
+      sum = _mm512_add_epi32(sum, v);
+    }
+    __m512i const score = _mm512_add_epi32(_mm512_set1_epi32(tables->base_score), _mm512_add_epi32(sum, sum));
+    __m512i const utf32s = _mm512_loadu_si512((const void *)&block->utf32s[i + 3]);
+    __m512i const indices = _mm512_loadu_si512((const void *)&block->indices[i + 3]);
+    __mmask16 const boundary = _mm512_cmpgt_epi32_mask(score, zero) & _mm512_cmpgt_epi32_mask(indices, zero) &
+                               _mm512_cmpneq_epi32_mask(utf32s, zero);
+    boundaries |= (uint64_t)boundary << i;
+  }
+  return boundaries;
+}
+
+#if defined(__GNUC__) && !defined(__clang__) && defined(__cplusplus)
+#pragma GCC diagnostic pop
+#endif
+#endif
+
+//
+// Kernel dispatch
+//
+// Kernels of block segmentation.  All kernels return the same boundaries.
+typedef enum hcbudoux_impl_kernel {
+  hcbudoux_impl_kernel_auto,    // The best kernel of the host
+  hcbudoux_impl_kernel_scalar,  // Portable C
+  hcbudoux_impl_kernel_avx2,    // x86 AVX2
+  hcbudoux_impl_kernel_avx512,  // x86 AVX-512F
+} hcbudoux_impl_kernel;
+
+#if HCBUDOUX_IMPL_DISPATCH
+static void hcbudoux_impl_cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#if defined(__GNUC__) || defined(__clang__)
+  __cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#else
+  int r[4];
+  __cpuidex(r, (int)leaf, (int)subleaf);
+  for (int i = 0; i < 4; ++i) {
+    regs[i] = (uint32_t)r[i];
+  }
+#endif
+}
+
+// Returns XCR0: the register states which are enabled by OS.
+static uint64_t hcbudoux_impl_xgetbv(void) {
+#if defined(__GNUC__) || defined(__clang__)
+  uint32_t eax = 0;
+  uint32_t edx = 0;
+  __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+  return ((uint64_t)edx << 32) | eax;
+#else
+  return (uint64_t)_xgetbv(0);
+#endif
+}
+#endif
+
+// Returns the best kernel of the host.
+static hcbudoux_impl_kernel hcbudoux_impl_detect_kernel(void) {
+#if HCBUDOUX_IMPL_DISPATCH
+  uint32_t regs[4] = {0, 0, 0, 0};
+  hcbudoux_impl_cpuid(0, 0, regs);
+  uint32_t const max_leaf = regs[0];
+  if (max_leaf < 1) {
+    return hcbudoux_impl_kernel_scalar;
+  }
+  hcbudoux_impl_cpuid(1, 0, regs);
+  bool const osxsave = (regs[2] >> 27) & 1;
+  bool const avx = (regs[2] >> 28) & 1;
+  uint64_t const xcr0 = osxsave ? hcbudoux_impl_xgetbv() : 0;
+  bool const ymm = avx && (xcr0 & 0x06) == 0x06;  // XMM, YMM
+  bool const zmm = ymm && (xcr0 & 0xe0) == 0xe0;  // opmask, ZMM0-15 upper half, ZMM16-31
+  bool avx2 = false;
+  bool avx512f = false;
+  if (max_leaf >= 7) {
+    hcbudoux_impl_cpuid(7, 0, regs);
+    avx2 = (regs[1] >> 5) & 1;
+    avx512f = (regs[1] >> 16) & 1;
+  }
+  if (zmm && avx2 && avx512f) {
+    return hcbudoux_impl_kernel_avx512;
+  }
+  if (ymm && avx2) {
+    return hcbudoux_impl_kernel_avx2;
+  }
+#endif
+  return hcbudoux_impl_kernel_scalar;
+}
+
+#if HCBUDOUX_IMPL_DISPATCH
+// Kernel of block segmentation.  hcbudoux_impl_kernel_auto means that the kernel is not detected yet.  Threads may
+// detect it concurrently, so it is accessed with relaxed atomic loads and stores: they store the same kernel.
+#if defined(__GNUC__) || defined(__clang__)
+#define HCBUDOUX_IMPL_LOAD_RELAXED(p) __atomic_load_n((p), __ATOMIC_RELAXED)
+#define HCBUDOUX_IMPL_STORE_RELAXED(p, v) __atomic_store_n((p), (v), __ATOMIC_RELAXED)
+#else
+#define HCBUDOUX_IMPL_LOAD_RELAXED(p) __iso_volatile_load32((p))
+#define HCBUDOUX_IMPL_STORE_RELAXED(p, v) __iso_volatile_store32((p), (v))
+#endif
+static int hcbudoux_impl_current_kernel = hcbudoux_impl_kernel_auto;
+#endif
+
+// Returns the kernel of block segmentation.  It detects the best kernel at first use.
+HCBUDOUX_IMPL_MAYBE_UNUSED static hcbudoux_impl_kernel hcbudoux_impl_get_kernel(void) {
+#if HCBUDOUX_IMPL_DISPATCH
+  int kernel = HCBUDOUX_IMPL_LOAD_RELAXED(&hcbudoux_impl_current_kernel);
+  if (kernel == hcbudoux_impl_kernel_auto) {
+    kernel = (int)hcbudoux_impl_detect_kernel();
+    HCBUDOUX_IMPL_STORE_RELAXED(&hcbudoux_impl_current_kernel, kernel);
+  }
+  return (hcbudoux_impl_kernel)kernel;
+#else
+  return hcbudoux_impl_kernel_scalar;
+#endif
+}
+
+// Forces the kernel of block segmentation for benchmarks and tests.  hcbudoux_impl_kernel_auto restores the best
+// kernel.  Returns false and doesn't change the kernel when the host doesn't support it.  It is not thread-safe: other
+// threads may segment with either kernel while it's changing the kernel.
+HCBUDOUX_IMPL_MAYBE_UNUSED static bool hcbudoux_impl_set_kernel(hcbudoux_impl_kernel kernel) {
+  hcbudoux_impl_kernel const best_kernel = hcbudoux_impl_detect_kernel();
+  if (kernel > best_kernel) {
+    return false;
+  }
+#if HCBUDOUX_IMPL_DISPATCH
+  int const current_kernel = (int)(kernel == hcbudoux_impl_kernel_auto ? best_kernel : kernel);
+  HCBUDOUX_IMPL_STORE_RELAXED(&hcbudoux_impl_current_kernel, current_kernel);
+#endif
+  return true;
+}
+
+HCBUDOUX_IMPL_MAYBE_UNUSED static uint64_t hcbudoux_impl_score_block(const hcbudoux_impl_block *block) {
+  hcbudoux_impl_kernel const kernel = hcbudoux_impl_get_kernel();
+#if HCBUDOUX_IMPL_DISPATCH
+  if (kernel == hcbudoux_impl_kernel_avx512) {
+    return hcbudoux_impl_score_block_avx512(block);
+  }
+  if (kernel == hcbudoux_impl_kernel_avx2) {
+    return hcbudoux_impl_score_block_avx2(block);
+  }
+#endif
+  (void)kernel;
+  return hcbudoux_impl_score_block_scalar(block);
+}
+
+//
+// Get next string view
+//
+// hcbudoux_ctx::impl.window packs 4 bits of each character of the window instead of its codepoint and offset.
+// c[i] is (window >> (i * 4)) & 0xf.  Since characters are contiguous, the offset of c[i] is curr_index minus the
+// sizes of c[i], ..., c[5].
+enum {
+  hcbudoux_impl_window_size_mask = 0x7,  // Size of the character in bytes (0 : end of the string)
+  hcbudoux_impl_window_nonzero = 0x8,    // The character is not U+0000
+};
+
+// Returns offset of c[i] in bytes.
+static int hcbudoux_impl_window_index(const hcbudoux_ctx *ctx, int i) {
+  int index = ctx->impl.curr_index;
+  for (int j = i; j < 6; ++j) {
+    index -= (int)((ctx->impl.window >> (j * 4)) & hcbudoux_impl_window_size_mask);
+  }
+  return index;
+}
+
+// Decodes a character at the offset index of the stream.  The character may begin in stream_pending: the bytes of the
+// previous chunks which were not decoded yet.  Then it's decoded from stream_pending and the head of the chunk.
+static uint32_t hcbudoux_impl_decode_stream(const hcbudoux_ctx *ctx, int index, int *size_in_bytes) {
+  int const base = ctx->impl.stream_base;
+  if (index >= base) {
+    return hcbudoux_impl_decode_utf8(ctx->impl.utf8_str, ctx->impl.stream_size, index - base, size_in_bytes);
+  }
+  uint8_t bytes[4];
+  int size = 0;
+  for (int i = index - base + ctx->impl.stream_pending_size; i < ctx->impl.stream_pending_size; ++i) {
+    bytes[size++] = ctx->impl.stream_pending[i];
+  }
+  for (int i = 0; i < ctx->impl.stream_size && size < 4; ++i) {
+    bytes[size++] = ctx->impl.utf8_str[i];
+  }
+  return hcbudoux_impl_decode_utf8(bytes, size, 0, size_in_bytes);
+}
+
+// Returns true when the stream needs the next chunk to decode the character at curr_index: the chunk has no more byte,
+// or the character is U+FFFD which reaches the end of the chunk (a sequence which may continue in the next chunk).
+// Then the rest of the chunk is kept in stream_pending, so the chunk may be released.
+static bool hcbudoux_impl_wait_stream(hcbudoux_ctx *ctx) {
+  if (ctx->impl.encoding != hcbudoux_impl_encoding_utf8_stream || ctx->impl.utf8_str_size_in_bytes != INT32_MAX) {
+    return false;
+  }
+  int const index = ctx->impl.curr_index;
+  int const end = ctx->impl.stream_base + ctx->impl.stream_size;
+  int size = 0;
+  uint32_t const c = hcbudoux_impl_decode_stream(ctx, index, &size);
+  if (size > 0 && (c != 0xfffd || index + size < end)) {
+    return false;
+  }
+  uint8_t bytes[3];
+  int const pending_size = end - index;
+  for (int i = 0; i < pending_size; ++i) {
+    int const base = ctx->impl.stream_base;
+    bytes[i] = index + i < base ? ctx->impl.stream_pending[index + i - base + ctx->impl.stream_pending_size]
+                                : ctx->impl.utf8_str[index + i - base];
+  }
+  for (int i = 0; i < pending_size; ++i) {
+    ctx->impl.stream_pending[i] = bytes[i];
+  }
+  ctx->impl.stream_pending_size = (uint8_t)pending_size;
+  ctx->impl.stream_base = end;
+  ctx->impl.stream_size = 0;
+  ctx->impl.utf8_str = 0;
+  return true;
+}
+
+// Decodes a character at utf8_str[index] of ctx.  The size of the character is in code units of the string.
+// While '\0' of a NUL-terminated string (hcbudoux_init() with -1) is not found, utf8_str_size_in_bytes is INT32_MAX and
+// the string is decoded without bounds checks.  The size of the string is set when the decoder reaches '\0'.
+static uint32_t hcbudoux_impl_decode_ctx(hcbudoux_ctx *ctx, int index, int *size_in_bytes) {
+  uint32_t c = 0;
+  if (ctx->impl.encoding == hcbudoux_impl_encoding_utf16) {
+    c = hcbudoux_impl_decode_utf16((const uint16_t *)(const void *)ctx->impl.utf8_str, ctx->impl.utf8_str_size_in_bytes,
+                                   index, size_in_bytes);
+  } else if (ctx->impl.encoding == hcbudoux_impl_encoding_utf32) {
+    c = hcbudoux_impl_decode_utf32((const uint32_t *)(const void *)ctx->impl.utf8_str, ctx->impl.utf8_str_size_in_bytes,
+                                   index, size_in_bytes);
+  } else if (ctx->impl.encoding == hcbudoux_impl_encoding_utf8_stream) {
+    return hcbudoux_impl_decode_stream(ctx, index, size_in_bytes);
+  } else if (!ctx->impl.nul_terminated) {
+    return hcbudoux_impl_decode_utf8(ctx->impl.utf8_str, ctx->impl.utf8_str_size_in_bytes, index, size_in_bytes);
+  } else {
+    c = hcbudoux_impl_decode_utf8_nul(ctx->impl.utf8_str, index, size_in_bytes);
+  }
+  if (ctx->impl.nul_terminated && c == 0) {
+    *size_in_bytes = 0;
+    ctx->impl.utf8_str_size_in_bytes = index;
+    ctx->impl.nul_terminated = false;
+  }
+  return c;
+}
+
+// Binds the model to ctx.  Records of the characters in the window are looked up again with the tables.  Since the
+// window has no codepoint, the characters are decoded again from utf8_str.
+static void hcbudoux_impl_bind_tables(hcbudoux_ctx *ctx, const hcbudoux_impl_tables *tables) {
+  ctx->impl.tables = tables;
+  for (int i = 0; i < 6; ++i) {
+    int size = 0;
+    uint32_t const c = (ctx->impl.window >> (i * 4)) & hcbudoux_impl_window_size_mask
+                           ? hcbudoux_impl_decode_ctx(ctx, hcbudoux_impl_window_index(ctx, i), &size)
+                           : 0;
+    ctx->impl.unigrams[i] = tables ? hcbudoux_impl_find_unigram(&tables->uw, c) : 0;
+    ctx->impl.masks[i] = tables ? tables->uw.masks[ctx->impl.unigrams[i]] : 0;
+  }
+  for (int i = 0; i < 4; ++i) {
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+    ctx->impl.bigrams[i] = -1;
+    ctx->impl.trigrams[i] = -1;
+#else
+    ctx->impl.bigrams[i] =
+        tables ? hcbudoux_impl_lookup_bigram(tables, &ctx->impl.unigrams[i + 1], &ctx->impl.masks[i + 1]) : 0;
+    ctx->impl.trigrams[i] =
+        tables ? hcbudoux_impl_lookup_trigram(tables, &ctx->impl.unigrams[i], &ctx->impl.masks[i]) : 0;
+#endif
+  }
+}
+
+// Sets [start, end) of the string to span.  Offsets of hcbudoux_init_utf32() map the indices of code points.
+static void hcbudoux_impl_set_span(const hcbudoux_ctx *ctx, hcbudoux_span *span, int start, int end) {
+  if (ctx->impl.offsets) {
+    start = ctx->impl.offsets[start];
+    end = ctx->impl.offsets[end];
+  }
+  span->offset = start;
+  span->length = end - start;
+}
+
+// Decodes the next character at curr_index and shifts it into the window.  tables may be null (no model).
+static void hcbudoux_impl_shift_window(hcbudoux_ctx *ctx, const hcbudoux_impl_tables *tables) {
+  // Read a UTF-8 character
+  int new_utf32_char_size_in_bytes = 0;
+  uint32_t const new_utf32_char = hcbudoux_impl_decode_ctx(ctx, ctx->impl.curr_index, &new_utf32_char_size_in_bytes);
+
+  // Add new character to the window.  It's a single shift of the packed sizes.
+  uint32_t const nonzero = new_utf32_char ? (uint32_t)hcbudoux_impl_window_nonzero : 0u;
+  ctx->impl.window = (ctx->impl.window >> 4) | (((uint32_t)new_utf32_char_size_in_bytes | nonzero) << (5 * 4));
+
+  // Look up records only once per character.  New character makes one new bigram and one new trigram.
+  // With branch and bound, they are looked up lazily by hcbudoux_impl_is_positive().
+  {
+    ctx->impl.unigrams[0] = ctx->impl.unigrams[1];
+    ctx->impl.unigrams[1] = ctx->impl.unigrams[2];
+    ctx->impl.unigrams[2] = ctx->impl.unigrams[3];
+    ctx->impl.unigrams[3] = ctx->impl.unigrams[4];
+    ctx->impl.unigrams[4] = ctx->impl.unigrams[5];
+    ctx->impl.unigrams[5] = tables ? hcbudoux_impl_find_unigram(&tables->uw, new_utf32_char) : 0;
+
+    ctx->impl.masks[0] = ctx->impl.masks[1];
+    ctx->impl.masks[1] = ctx->impl.masks[2];
+    ctx->impl.masks[2] = ctx->impl.masks[3];
+    ctx->impl.masks[3] = ctx->impl.masks[4];
+    ctx->impl.masks[4] = ctx->impl.masks[5];
+    ctx->impl.masks[5] = tables ? tables->uw.masks[ctx->impl.unigrams[5]] : 0;
+
+    ctx->impl.bigrams[0] = ctx->impl.bigrams[1];
+    ctx->impl.bigrams[1] = ctx->impl.bigrams[2];
+    ctx->impl.bigrams[2] = ctx->impl.bigrams[3];
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+    ctx->impl.bigrams[3] = -1;
+#else
+    ctx->impl.bigrams[3] =
+        tables ? hcbudoux_impl_lookup_bigram(tables, &ctx->impl.unigrams[4], &ctx->impl.masks[4]) : 0;
+#endif
+
+    ctx->impl.trigrams[0] = ctx->impl.trigrams[1];
+    ctx->impl.trigrams[1] = ctx->impl.trigrams[2];
+    ctx->impl.trigrams[2] = ctx->impl.trigrams[3];
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+    ctx->impl.trigrams[3] = -1;
+#else
+    ctx->impl.trigrams[3] =
+        tables ? hcbudoux_impl_lookup_trigram(tables, &ctx->impl.unigrams[3], &ctx->impl.masks[3]) : 0;
+#endif
+  }
+
+  ctx->impl.curr_index += new_utf32_char_size_in_bytes;
+}
+
+// Get next string view with the tables which are bound to ctx.  tables may be null (no model).
+static bool hcbudoux_impl_getnext_tables(hcbudoux_ctx *ctx, hcbudoux_span *span, const hcbudoux_impl_tables *tables) {
+  for (;;) {
+    if (hcbudoux_impl_wait_stream(ctx)) {
+      break;
+    }
+    hcbudoux_impl_shift_window(ctx, tables);
+
+    {
+      int const start = ctx->impl.last_index;
+      int const end = hcbudoux_impl_window_index(ctx, 3);
+      int const length = end - start;
+
+      // c[3] represents 0 offset (current) character.
+      if (ctx->impl.window & (uint32_t)hcbudoux_impl_window_nonzero << (3 * 4)) {
+        // Queue contains valid input.
+
+        // Evaluate queue
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+        bool const positive = tables ? hcbudoux_impl_is_positive(tables, ctx->impl.unigrams, ctx->impl.masks,
+                                                                  ctx->impl.bigrams, ctx->impl.trigrams)
+                                     : false;
+#else
+        bool const positive = tables ? hcbudoux_impl_compute_score(tables, ctx->impl.unigrams, ctx->impl.masks,
+                                                                   ctx->impl.bigrams, ctx->impl.trigrams) > 0
+                                     : false;
+#endif
+
+        // If score > 0, it means we can put &nbsp; between character at
+        // c[2] and c[3]. Also, since the first valid character may
+        // have positive score, we should avoid it (length <= 0).
+        if (!positive || length <= 0) {
+          continue;
+        }
+
+        hcbudoux_impl_set_span(ctx, span, start, end);
+        ctx->impl.last_index = end;
+        return true;  // true indicates valid span
+      } else if (end >= ctx->impl.utf8_str_size_in_bytes) {
+        // Queue is empty. (index exceeded the last character)
+
+        if (length <= 0 || start >= ctx->impl.utf8_str_size_in_bytes) {
+          break;
+        }
+
+        // If we have the last valid chunk, return it before entering EOF state.
+        if (length > 0 && start < ctx->impl.utf8_str_size_in_bytes) {
+          // Set EOF state for next time.  Make sure we won't process further.
+          hcbudoux_impl_set_span(ctx, span, start, end);
+          ctx->impl.curr_index = ctx->impl.utf8_str_size_in_bytes;
+          ctx->impl.last_index = ctx->impl.utf8_str_size_in_bytes;
+          return true;  // true indicates valid span
+        }
+
+        // There's nothing to do.  Return empty span.
+        break;
+      }
+    }
+  }
+
+  // Return empty span.
+  span->offset = 0;
+  span->length = 0;
+  return false;  // false indicates invalid span, end of string
+}
+
+static bool hcbudoux_impl_getnext(hcbudoux_ctx *ctx, hcbudoux_span *span, hcbudoux_impl_lang lang) {
+  const hcbudoux_impl_tables *const tables = hcbudoux_impl_get_tables(lang);
+
+  // Refresh records when the model is changed.  The window of a stream may have characters whose chunk is released, so
+  // they can't be decoded again and a stream keeps the model of hcbudoux_init_stream().  Offset -1 tells the misuse
+  // from the end of the chunk.
+  if (ctx->impl.tables != tables) {
+    if (ctx->impl.encoding == hcbudoux_impl_encoding_utf8_stream) {
+      span->offset = -1;
+      span->length = 0;
+      return false;
+    }
+    hcbudoux_impl_bind_tables(ctx, tables);
+  }
+  return hcbudoux_impl_getnext_tables(ctx, span, tables);
+}
+
+//
+// Get breaks
+//
+// hcbudoux_getbreaks() hands over the window between ctx and a block.  The last 5 characters of the previous block are
+// c[1], ..., c[5] of the window, and the last position of the block is the window of ctx.
+
+// Loads the window of ctx to the block as the previous block.  The next hcbudoux_impl_fill_block() continues from ctx.
+static void hcbudoux_impl_load_block(hcbudoux_impl_block *block, const hcbudoux_ctx *ctx) {
+  const hcbudoux_impl_tables *const tables = ctx->impl.tables;
+  int const n = hcbudoux_impl_block_size;
+  block->tables = tables;
+  block->utf8_str = ctx->impl.utf8_str;
+  block->utf8_str_size_in_bytes = ctx->impl.utf8_str_size_in_bytes;
+  block->curr_index = ctx->impl.curr_index;
+  block->count = n;
+  for (int i = 0; i < 5; ++i) {
+    int size = 0;
+    int const index = hcbudoux_impl_window_index(ctx, i + 1);
+    block->utf32s[n + i] = (ctx->impl.window >> ((i + 1) * 4)) & hcbudoux_impl_window_size_mask
+                               ? hcbudoux_impl_decode_utf8(ctx->impl.utf8_str, ctx->impl.utf8_str_size_in_bytes, index,
+                                                           &size)
+                               : 0;
+    block->indices[n + i] = index;
+    block->unigrams[n + i] = ctx->impl.unigrams[i + 1];
+    block->masks[n + i] = ctx->impl.masks[i + 1];
+  }
+  for (int i = 0; i < 3; ++i) {
+    block->bigrams[n + i] = hcbudoux_impl_lookup_bigram(tables, &block->unigrams[n + i + 1], &block->masks[n + i + 1]);
+    block->trigrams[n + i] = hcbudoux_impl_lookup_trigram(tables, &block->unigrams[n + i], &block->masks[n + i]);
+  }
+}
+
+// Stores the last position of the block to the window of ctx.  The next hcbudoux_impl_getnext_tables() continues from
+// the block.
+static void hcbudoux_impl_store_block(hcbudoux_ctx *ctx, const hcbudoux_impl_block *block) {
+  int const n = hcbudoux_impl_block_size;
+  uint32_t window = 0;
+  for (int i = 0; i < 6; ++i) {
+    int const next_index = i < 5 ? block->indices[n + i] : block->curr_index;
+    uint32_t const size = (uint32_t)(next_index - block->indices[n - 1 + i]);
+    uint32_t const nonzero = block->utf32s[n - 1 + i] ? (uint32_t)hcbudoux_impl_window_nonzero : 0u;
+    window |= (size | nonzero) << (i * 4);
+    ctx->impl.unigrams[i] = block->unigrams[n - 1 + i];
+    ctx->impl.masks[i] = block->masks[n - 1 + i];
+  }
+  for (int i = 0; i < 4; ++i) {
+    ctx->impl.bigrams[i] = block->bigrams[n - 1 + i];
+    ctx->impl.trigrams[i] = block->trigrams[n - 1 + i];
+  }
+  ctx->impl.window = window;
+  ctx->impl.curr_index = block->curr_index;
+}
+
+// Writes the ends of the next spans to offsets[].  While offsets has room for all boundaries of a block, a UTF-8 string
+// of known size is segmented by blocks.  The rest goes span by span.
+static int hcbudoux_impl_getbreaks(hcbudoux_ctx *ctx, int *offsets, int capacity) {
+  const hcbudoux_impl_tables *const tables = ctx->impl.tables;
+  int count = 0;
+  if (tables && ctx->impl.encoding == hcbudoux_impl_encoding_utf8 && !ctx->impl.nul_terminated &&
+      ctx->impl.last_index < ctx->impl.utf8_str_size_in_bytes && capacity >= hcbudoux_impl_block_size) {
+    hcbudoux_impl_block block;
+    bool filled = false;
+    hcbudoux_impl_load_block(&block, ctx);
+    while (capacity - count >= hcbudoux_impl_block_size && hcbudoux_impl_fill_block(&block)) {
+      for (uint64_t bits = hcbudoux_impl_score_block(&block); bits; bits &= bits - 1) {
+        offsets[count++] = block.indices[hcbudoux_impl_ctz64(bits) + 3];
+      }
+      filled = true;
+    }
+    if (filled) {
+      hcbudoux_impl_store_block(ctx, &block);
+      ctx->impl.last_index = count > 0 ? offsets[count - 1] : ctx->impl.last_index;
+    }
+  }
+  for (hcbudoux_span span; count < capacity && hcbudoux_impl_getnext_tables(ctx, &span, tables);) {
+    offsets[count++] = span.offset + span.length;
+  }
+  return count;
+}
+
+// Sets the breaks of the rest of the string to bitmap[].  A break is the offset of a span except the first span of the
+// string.  Since the next span begins at last_index, its break is set first and the block sets the others.
+static int hcbudoux_impl_getbreaks_bitmap(hcbudoux_ctx *ctx, uint64_t *bitmap) {
+  const hcbudoux_impl_tables *const tables = ctx->impl.tables;
+  int count = 0;
+  bool first = ctx->impl.last_index == 0;  // The next span is the first span of the string, or its break is set
+  if (tables && ctx->impl.encoding == hcbudoux_impl_encoding_utf8 && !ctx->impl.nul_terminated &&
+      ctx->impl.last_index < ctx->impl.utf8_str_size_in_bytes) {
+    hcbudoux_impl_block block;
+    int last_index = ctx->impl.last_index;
+    if (!first) {
+      bitmap[last_index >> 6] |= (uint64_t)1 << (last_index & 63);
+      ++count;
+    }
+    hcbudoux_impl_load_block(&block, ctx);
+    while (hcbudoux_impl_fill_block(&block)) {
+      for (uint64_t bits = hcbudoux_impl_score_block(&block); bits; bits &= bits - 1) {
+        last_index = block.indices[hcbudoux_impl_ctz64(bits) + 3];
+        bitmap[last_index >> 6] |= (uint64_t)1 << (last_index & 63);
+        ++count;
+      }
+    }
+    hcbudoux_impl_store_block(ctx, &block);
+    ctx->impl.last_index = last_index;
+    first = true;
+  }
+  for (hcbudoux_span span; hcbudoux_impl_getnext_tables(ctx, &span, tables); first = false) {
+    if (!first) {
+      bitmap[span.offset >> 6] |= (uint64_t)1 << (span.offset & 63);
+      ++count;
+    }
+  }
+  return count;
+}
+
+// Returns the score of the window of ctx.  With branch and bound, n-gram records which are not looked up yet are looked
+// up here.
+static int hcbudoux_impl_window_score(hcbudoux_ctx *ctx, const hcbudoux_impl_tables *tables) {
+#if HCBUDOUX_IMPL_BRANCH_AND_BOUND
+  for (int i = 0; i < 4; ++i) {
+    if (ctx->impl.bigrams[i] < 0) {
+      ctx->impl.bigrams[i] = hcbudoux_impl_lookup_bigram(tables, &ctx->impl.unigrams[i + 1], &ctx->impl.masks[i + 1]);
+    }
+    if (ctx->impl.trigrams[i] < 0) {
+      ctx->impl.trigrams[i] = hcbudoux_impl_lookup_trigram(tables, &ctx->impl.unigrams[i], &ctx->impl.masks[i]);
+    }
+  }
+#endif
+  return hcbudoux_impl_compute_score(tables, ctx->impl.unigrams, ctx->impl.masks, ctx->impl.bigrams,
+                                     ctx->impl.trigrams);
+}
+
+// Writes the scores and indices (not mapped by offsets of hcbudoux_init_utf32()) of the next characters, and whether
+// they are U+0000 to nuls[] if it's not null.  Like hcbudoux_impl_getbreaks(), a UTF-8 string of known size is scored
+// by blocks while scores[] has room for a whole block.  A position of the block (or the window of ctx) has a character
+// of the string when the size of its current character is not 0.
+static int hcbudoux_impl_getscores(hcbudoux_ctx *ctx, int *scores, int *indices, bool *nuls, int capacity) {
+  const hcbudoux_impl_tables *const tables = ctx->impl.tables;
+  int count = 0;
+  if (tables && ctx->impl.encoding == hcbudoux_impl_encoding_utf8 && !ctx->impl.nul_terminated &&
+      capacity >= hcbudoux_impl_block_size) {
+    hcbudoux_impl_block block;
+    bool filled = false;
+    hcbudoux_impl_load_block(&block, ctx);
+    while (capacity - count >= hcbudoux_impl_block_size && hcbudoux_impl_fill_block(&block)) {
+      for (int i = 0; i < hcbudoux_impl_block_size; ++i) {
+        if (block.indices[i + 4] > block.indices[i + 3]) {
+          if (indices) {
+            indices[count] = block.indices[i + 3];
+          }
+          if (nuls) {
+            nuls[count] = block.utf32s[i + 3] == 0;
+          }
+          scores[count++] = hcbudoux_impl_compute_score(tables, &block.unigrams[i], &block.masks[i],
+                                                        &block.bigrams[i], &block.trigrams[i]);
+        }
+      }
+      filled = true;
+    }
+    if (filled) {
+      hcbudoux_impl_store_block(ctx, &block);
+    }
+  }
+  while (count < capacity && !hcbudoux_impl_wait_stream(ctx)) {
+    hcbudoux_impl_shift_window(ctx, tables);
+    int const index = hcbudoux_impl_window_index(ctx, 3);
+    if (!(ctx->impl.window & (uint32_t)hcbudoux_impl_window_size_mask << (3 * 4))) {
+      if (index >= ctx->impl.utf8_str_size_in_bytes) {
+        break;
+      }
+      continue;
+    }
+    if (indices) {
+      indices[count] = index;
+    }
+    if (nuls) {
+      nuls[count] = !(ctx->impl.window & (uint32_t)hcbudoux_impl_window_nonzero << (3 * 4));
+    }
+    scores[count++] = tables ? hcbudoux_impl_window_score(ctx, tables) : 0;
+  }
+  return count;
+}
+
+// Sets the breaks of each threshold to its bitmap from one pass of hcbudoux_impl_getscores().  A character is a break
+// of thresholds[k] when its score is greater than thresholds[k], and it's not the first character of the string nor
+// U+0000 (same as hcbudoux_impl_getnext_tables() for the threshold 0).
+static void hcbudoux_impl_getbreaks_thresholds(hcbudoux_ctx *ctx, const int *thresholds, int threshold_count,
+                                               uint64_t *const *bitmaps) {
+  enum { capacity = hcbudoux_impl_block_size * 4 };
+  int scores[capacity];
+  int indices[capacity];
+  bool nuls[capacity];
+  if (!ctx->impl.tables) {
+    return;
+  }
+  for (int count = 0; (count = hcbudoux_impl_getscores(ctx, scores, indices, nuls, capacity)) > 0;) {
+    for (int i = 0; i < count; ++i) {
+      int const index = indices[i];
+      if (index == 0 || nuls[i]) {
+        continue;
+      }
+      int const offset = ctx->impl.offsets ? ctx->impl.offsets[index] : index;
+      for (int k = 0; k < threshold_count; ++k) {
+        bitmaps[k][offset >> 6] |= (uint64_t)(scores[i] > thresholds[k]) << (offset & 63);
+      }
+    }
+  }
+}
+
+//
+// Public API: Initialize with a model
+//
+void hcbudoux_init_lang(hcbudoux_ctx *ctx, hcbudoux_lang lang, const void *utf8_str, int utf8_str_size_in_bytes) {
+  hcbudoux_init(ctx, utf8_str, utf8_str_size_in_bytes);
+  hcbudoux_impl_bind_tables(ctx, hcbudoux_impl_get_tables((hcbudoux_impl_lang)lang));
+}
+
+//
+// Public API: Initialize with a UTF-16 string
+//
+void hcbudoux_init_utf16(hcbudoux_ctx *ctx, const void *utf16_str, int utf16_str_size_in_units) {
+  hcbudoux_init(ctx, utf16_str, utf16_str_size_in_units);
+  ctx->impl.encoding = hcbudoux_impl_encoding_utf16;
+}
+
+void hcbudoux_init_lang_utf16(hcbudoux_ctx *ctx, hcbudoux_lang lang, const void *utf16_str,
+                              int utf16_str_size_in_units) {
+  hcbudoux_init_utf16(ctx, utf16_str, utf16_str_size_in_units);
+  hcbudoux_impl_bind_tables(ctx, hcbudoux_impl_get_tables((hcbudoux_impl_lang)lang));
+}
+
+//
+// Public API: Initialize with code points
+//
+void hcbudoux_init_utf32(hcbudoux_ctx *ctx, const uint32_t *utf32_str, const int *offsets, int utf32_str_length) {
+  hcbudoux_init(ctx, utf32_str, utf32_str_length);
+  ctx->impl.encoding = hcbudoux_impl_encoding_utf32;
+  ctx->impl.offsets = offsets;
+}
+
+void hcbudoux_init_lang_utf32(hcbudoux_ctx *ctx, hcbudoux_lang lang, const uint32_t *utf32_str, const int *offsets,
+                              int utf32_str_length) {
+  hcbudoux_init_utf32(ctx, utf32_str, offsets, utf32_str_length);
+  hcbudoux_impl_bind_tables(ctx, hcbudoux_impl_get_tables((hcbudoux_impl_lang)lang));
+}
+
+//
+// Public API: Get next string view
+//
+#if defined(HCBUDOUX_USE_JA) && (HCBUDOUX_USE_JA)
+bool hcbudoux_getnext_ja(hcbudoux_ctx *ctx, hcbudoux_span *span) {
+  return hcbudoux_impl_getnext(ctx, span, hcbudoux_impl_lang_ja);
+}
+#endif
 
 #if defined(HCBUDOUX_USE_JA_KNBC) && (HCBUDOUX_USE_JA_KNBC)
 bool hcbudoux_getnext_ja_knbc(hcbudoux_ctx *ctx, hcbudoux_span *span) {
@@ -625,6 +2458,91 @@ bool hcbudoux_getnext_zh_hant(hcbudoux_ctx *ctx, hcbudoux_span *span) {
   return hcbudoux_impl_getnext(ctx, span, hcbudoux_impl_lang_zh_hant);
 }
 #endif
+
+bool hcbudoux_getnext(hcbudoux_ctx *ctx, hcbudoux_span *span) {
+  return hcbudoux_impl_getnext_tables(ctx, span, ctx->impl.tables);
+}
+
+//
+// Public API: Get breaks
+//
+int hcbudoux_getbreaks(hcbudoux_ctx *ctx, int *offsets, int capacity) {
+  return hcbudoux_impl_getbreaks(ctx, offsets, capacity);
+}
+
+int hcbudoux_find_breaks(hcbudoux_lang lang, const void *utf8_str, int utf8_str_size_in_bytes, int *offsets,
+                         int capacity) {
+  hcbudoux_ctx ctx;
+  hcbudoux_init_lang(&ctx, lang, utf8_str, utf8_str_size_in_bytes);
+  return hcbudoux_impl_getbreaks(&ctx, offsets, capacity);
+}
+
+int hcbudoux_getbreaks_bitmap(hcbudoux_ctx *ctx, uint64_t *bitmap) {
+  return hcbudoux_impl_getbreaks_bitmap(ctx, bitmap);
+}
+
+int hcbudoux_find_breaks_bitmap(hcbudoux_lang lang, const void *utf8_str, int utf8_str_size_in_bytes,
+                                uint64_t *bitmap) {
+  hcbudoux_ctx ctx;
+  hcbudoux_init_lang(&ctx, lang, utf8_str, utf8_str_size_in_bytes);
+  return hcbudoux_impl_getbreaks_bitmap(&ctx, bitmap);
+}
+
+//
+// Public API: Get scores
+//
+int hcbudoux_getscores(hcbudoux_ctx *ctx, int *scores, int *offsets, int capacity) {
+  int const count = hcbudoux_impl_getscores(ctx, scores, offsets, 0, capacity);
+  if (offsets && ctx->impl.offsets) {
+    for (int i = 0; i < count; ++i) {
+      offsets[i] = ctx->impl.offsets[offsets[i]];
+    }
+  }
+  return count;
+}
+
+int hcbudoux_find_scores(hcbudoux_lang lang, const void *utf8_str, int utf8_str_size_in_bytes, int *scores,
+                         int *offsets, int capacity) {
+  hcbudoux_ctx ctx;
+  hcbudoux_init_lang(&ctx, lang, utf8_str, utf8_str_size_in_bytes);
+  return hcbudoux_impl_getscores(&ctx, scores, offsets, 0, capacity);
+}
+
+//
+// Public API: Get breaks of thresholds
+//
+void hcbudoux_getbreaks_thresholds(hcbudoux_ctx *ctx, const int *thresholds, int threshold_count,
+                                   uint64_t *const *bitmaps) {
+  hcbudoux_impl_getbreaks_thresholds(ctx, thresholds, threshold_count, bitmaps);
+}
+
+void hcbudoux_find_breaks_thresholds(hcbudoux_lang lang, const void *utf8_str, int utf8_str_size_in_bytes,
+                                     const int *thresholds, int threshold_count, uint64_t *const *bitmaps) {
+  hcbudoux_ctx ctx;
+  hcbudoux_init_lang(&ctx, lang, utf8_str, utf8_str_size_in_bytes);
+  hcbudoux_impl_getbreaks_thresholds(&ctx, thresholds, threshold_count, bitmaps);
+}
+
+//
+// Public API: Stream
+//
+void hcbudoux_init_stream(hcbudoux_ctx *ctx, hcbudoux_lang lang) {
+  hcbudoux_init(ctx, 0, -1);
+  ctx->impl.nul_terminated = false;
+  ctx->impl.encoding = hcbudoux_impl_encoding_utf8_stream;
+  hcbudoux_impl_bind_tables(ctx, hcbudoux_impl_get_tables((hcbudoux_impl_lang)lang));
+}
+
+// The previous chunk has been decoded up to stream_base, and its rest is in stream_pending.
+void hcbudoux_feed(hcbudoux_ctx *ctx, const void *utf8_chunk, int utf8_chunk_size_in_bytes) {
+  ctx->impl.utf8_str = (const uint8_t *)utf8_chunk;
+  ctx->impl.stream_size = utf8_chunk_size_in_bytes;
+}
+
+// The size of the stream is known.  hcbudoux_impl_wait_stream() doesn't wait anymore.
+void hcbudoux_finish(hcbudoux_ctx *ctx) {
+  ctx->impl.utf8_str_size_in_bytes = ctx->impl.stream_base + ctx->impl.stream_size;
+}
 #endif  // defined(HCBUDOUX_IMPL)
 
 #ifdef __cplusplus
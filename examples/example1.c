@@ -7,7 +7,6 @@
 #define HCBUDOUX_USE_JA 1  // Use model : ja
 #include <assert.h>        // static_assert
 #include <stdio.h>         // printf
-#include <string.h>        // strlen
 
 #include "hcbudoux.h"
 #if defined(_WIN32)
@@ -24,7 +23,6 @@ void init(void) {}
 
 int main(int argc, const char **argv) {
   static char const utf8Str[] = u8"次の決闘がまもなく始まる！";
-  int const utf8Strlen = (int)strlen(utf8Str);
 
   (void)argc;
   (void)argv;
@@ -32,8 +30,9 @@ int main(int argc, const char **argv) {
   static_assert(sizeof(utf8Str) == 40, "Basic UTF-8 test");
   init();
 
+  // -1 : utf8Str is terminated with '\0'.  hcbudoux finds the end while segmenting, so strlen() is not needed.
   hcbudoux_ctx ctx;
-  hcbudoux_init(&ctx, utf8Str, utf8Strlen);
+  hcbudoux_init(&ctx, utf8Str, -1);
 
   hcbudoux_span span;
   while (hcbudoux_getnext_ja(&ctx, &span)) {
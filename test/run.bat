@@ -10,6 +10,34 @@ echo %MSVC% %Options% test2.cpp
 call %MSVC% %Options% test2.cpp || goto :ERROR
                     .\test2.exe || goto :ERROR
 
+echo %MSVC% %Options% test3.c
+call %MSVC% %Options% test3.c   || goto :ERROR
+                    .\test3.exe || goto :ERROR
+
+echo %MSVC% %Options% test4.c
+call %MSVC% %Options% test4.c   || goto :ERROR
+                    .\test4.exe || goto :ERROR
+
+echo %MSVC% %Options% test5.c
+call %MSVC% %Options% test5.c   || goto :ERROR
+                    .\test5.exe || goto :ERROR
+
+echo %MSVC% %Options% test6.c
+call %MSVC% %Options% test6.c   || goto :ERROR
+                    .\test6.exe || goto :ERROR
+
+echo %MSVC% %Options% /arch:AVX2 test7.c
+call %MSVC% %Options% /arch:AVX2 test7.c || goto :ERROR
+                               .\test7.exe || goto :ERROR
+
+echo %MSVC% %Options% /DHCBUDOUX_BRANCH_AND_BOUND=1 test8.c
+call %MSVC% %Options% /DHCBUDOUX_BRANCH_AND_BOUND=1 test8.c || goto :ERROR
+                                                  .\test8.exe || goto :ERROR
+
+echo %MSVC% %Options% test9.c
+call %MSVC% %Options% test9.c   || goto :ERROR
+                    .\test9.exe || goto :ERROR
+
 :OK
 %Exit_OK%
 
@@ -4,7 +4,7 @@
 #include <stdint.h>   // uint8_t, uint32_t, uint64_t
 #include <stdio.h>    // printf
 #include <stdlib.h>   // EXIT_SUCCESS, EXIT_FAILURE
-#include <string.h>   // strlen
+#include <string.h>   // memcmp, memset, strlen
 
 #include "hcbudoux.h"
 #if defined(_WIN32)
@@ -19,18 +19,111 @@ void init(void) { SetConsoleOutputCP(CP_UTF8); }
 void init(void) {}
 #endif
 
-static bool test(hcbudoux_impl_lang lang, const void *utf8String, const void *utf8ExpectedResults) {
+enum {
+  testBound = 1,             // hcbudoux_init_lang() and hcbudoux_getnext() instead of hcbudoux_impl_getnext()
+  testNul = 2,               // NUL-terminated string (size -1)
+  testUtf16 = 4,             // UTF-16 string.  Spans are mapped back to UTF-8
+  testUtf32 = 8,             // Code points.  Spans are mapped back to UTF-8
+  testUtf32Offsets = 12,     // Code points with UTF-8 offsets.  Spans are in UTF-8
+  testEncodingMask = 12,     //
+  testAll = 16,              //
+  maxConvertedLength = 1024  //
+};
+
+// Converts utf8String to UTF-16 (utf16 is true) or UTF-32.  utf8Offsets[i] is the UTF-8 offset of code unit i.
+// Returns the number of code units.
+static int convertUtf8(const char *utf8String, bool utf16, uint16_t *utf16String, uint32_t *utf32String,
+                       int *utf8Offsets) {
+  int const utf8StringSizeInBytes = (int)strlen(utf8String);
+  int length = 0;
+  int index = 0;
+  while (index < utf8StringSizeInBytes) {
+    int size = 0;
+    uint32_t const c = hcbudoux_impl_decode_utf8((const uint8_t *)utf8String, utf8StringSizeInBytes, index, &size);
+    if (!utf16) {
+      utf32String[length] = c;
+    } else if (c >= 0x10000) {
+      utf16String[length] = (uint16_t)(0xd800 + ((c - 0x10000) >> 10));
+      utf8Offsets[length++] = index;
+      utf16String[length] = (uint16_t)(0xdc00 + ((c - 0x10000) & 0x3ff));
+    } else {
+      utf16String[length] = (uint16_t)c;
+    }
+    utf8Offsets[length++] = index;
+    index += size;
+  }
+  utf16String[length] = 0;
+  utf32String[length] = 0;
+  utf8Offsets[length] = index;
+  return length;
+}
+
+static uint16_t utf16String[maxConvertedLength];
+static uint32_t utf32String[maxConvertedLength];
+static int utf8Offsets[maxConvertedLength];
+
+// Initializes ctx with utf8String or its conversion (utf16String, utf32String and utf8Offsets) for the flags.
+static void initContext(hcbudoux_ctx *ctx, hcbudoux_impl_lang lang, int flags, const void *utf8String, int initSize) {
+  bool const bound = (flags & testBound) != 0;
+  int const encoding = flags & testEncodingMask;
+  const int *const offsets = encoding == testUtf32Offsets ? utf8Offsets : NULL;
+  if (encoding == testUtf16) {
+    if (bound) {
+      hcbudoux_init_lang_utf16(ctx, (hcbudoux_lang)lang, utf16String, initSize);
+    } else {
+      hcbudoux_init_utf16(ctx, utf16String, initSize);
+    }
+  } else if (encoding != 0) {
+    if (bound) {
+      hcbudoux_init_lang_utf32(ctx, (hcbudoux_lang)lang, utf32String, offsets, initSize);
+    } else {
+      hcbudoux_init_utf32(ctx, utf32String, offsets, initSize);
+    }
+  } else if (bound) {
+    hcbudoux_init_lang(ctx, (hcbudoux_lang)lang, utf8String, initSize);
+  } else {
+    hcbudoux_init(ctx, utf8String, initSize);
+  }
+}
+
+// Segments utf8String with hcbudoux_impl_getnext(), or hcbudoux_init_lang() and hcbudoux_getnext() (testBound).
+// testBound also compares hcbudoux_getbreaks_bitmap() with the spans.  Its bitmap has exactly the documented number of
+// words for the end of the string, and the word after it must be untouched.
+static bool test(hcbudoux_impl_lang lang, int flags, const void *utf8String, const void *utf8ExpectedResults) {
+  static const char *const encodingNames[] = {"", ", utf16", ", utf32", ", utf32 with offsets"};
+  static uint64_t expectedBitmap[maxConvertedLength / 64 + 2];
+  static uint64_t actualBitmap[maxConvertedLength / 64 + 2];
+  bool const bound = (flags & testBound) != 0;
+  bool const nul = (flags & testNul) != 0;
+  int const encoding = flags & testEncodingMask;
   int const utf8StringSizeInBytes = (int)strlen((const char *)utf8String);
+  int const convertedLength = encoding != 0 ? convertUtf8((const char *)utf8String, encoding == testUtf16, utf16String,
+                                                          utf32String, utf8Offsets)
+                                            : 0;
+  int const initSize = nul ? -1 : encoding != 0 ? convertedLength : utf8StringSizeInBytes;
+  bool const mapBack = encoding == testUtf16 || encoding == testUtf32;
+  int const stringEnd = mapBack ? convertedLength : utf8StringSizeInBytes;
+  int const words = (stringEnd + 63) / 64;
   const char *pExp = (const char *)utf8ExpectedResults;
 
   bool total = true;
   hcbudoux_ctx ctx;
-  hcbudoux_init(&ctx, utf8String, utf8StringSizeInBytes);
+  int spanCount = 0;
+  memset(expectedBitmap, 0, sizeof(expectedBitmap));
+  initContext(&ctx, lang, flags, utf8String, initSize);
   for (;;) {
     hcbudoux_span span;
-    if (!hcbudoux_impl_getnext(&ctx, &span, lang)) {
+    if (!(bound ? hcbudoux_getnext(&ctx, &span) : hcbudoux_impl_getnext(&ctx, &span, lang))) {
       break;
     }
+    if (spanCount++ > 0) {
+      expectedBitmap[span.offset / 64] |= (uint64_t)1 << (span.offset % 64);
+    }
+    if (mapBack) {
+      int const end = utf8Offsets[span.offset + span.length];
+      span.offset = utf8Offsets[span.offset];
+      span.length = end - span.offset;
+    }
 
     {
       int result = true;
@@ -61,8 +154,22 @@ static bool test(hcbudoux_impl_lang lang, const void *utf8String, const void *ut
     }
   }
   total &= (0 == *pExp);
+
+  if (bound) {
+    memset(actualBitmap, 0, sizeof(actualBitmap));
+    actualBitmap[words] = ~(uint64_t)0;
+    initContext(&ctx, lang, flags, utf8String, initSize);
+    int const breakCount = hcbudoux_getbreaks_bitmap(&ctx, actualBitmap);
+    expectedBitmap[words] = ~(uint64_t)0;
+    total &= breakCount == (spanCount > 0 ? spanCount - 1 : 0) &&
+             memcmp(expectedBitmap, actualBitmap, sizeof(actualBitmap[0]) * (size_t)(words + 1)) == 0;
+    if (!total) {
+      printf("bitmap   = %d breaks, expected %d breaks\n", breakCount, spanCount > 0 ? spanCount - 1 : 0);
+    }
+  }
   printf("%s", total ? "OK" : "NG");
-  printf(": utf8String = [%.*s], len=%d\n", utf8StringSizeInBytes, (const char *)utf8String, utf8StringSizeInBytes);
+  printf(": utf8String = [%.*s], len=%d%s%s%s\n", utf8StringSizeInBytes, (const char *)utf8String,
+         utf8StringSizeInBytes, bound ? ", bound" : "", nul ? ", nul" : "", encodingNames[encoding / testUtf16]);
   return total;
 }
 
@@ -196,6 +303,40 @@ static bool test_all(void) {
           u8"受惠。\0"
         },
         // ^^^ Test phrases from https://github.com/google/budoux/blob/v0.6.4/tests/test_parser.py#L109-L164 ^^^
+
+        { hcbudoux_impl_lang_ja, // Surrogate pairs in UTF-16
+          u8"今日は😀天気です。🍣を食べに行こう",
+          u8"今日は\0"
+          u8"😀天気です。\0"
+          u8"🍣を\0"
+          u8"食べに\0"
+          u8"行こう\0"
+        },
+
+        // Ill-formed UTF-8 is decoded as U+FFFD and spans keep the original bytes.
+        { hcbudoux_impl_lang_ja, // Stray continuation byte
+          u8"私の名前は\x80中野です",
+          u8"私の\0"
+          u8"名前は\0"
+          u8"\x80中野です\0"
+        },
+        { hcbudoux_impl_lang_ja, // Truncated sequence at the end
+          u8"私の名前は中野です\xe3\x81",
+          u8"私の\0"
+          u8"名前は\0"
+          u8"中野です\xe3\x81\0"
+        },
+        { hcbudoux_impl_lang_ja, // Invalid lead bytes
+          u8"\xff\xfe私の名前は中野です",
+          u8"\xff\xfe私の\0"
+          u8"名前は\0"
+          u8"中野です\0"
+        },
+        { hcbudoux_impl_lang_ja, // Overlong, surrogate and out of range sequences
+          u8"今日は\xc0\xaf\xed\xa0\x80\xf4\x90\x80\x80天気です。",
+          u8"今日は\0"
+          u8"\xc0\xaf\xed\xa0\x80\xf4\x90\x80\x80天気です。\0"
+        },
         // TODO: There's no Thai test phrase.  We must have it.
       // clang-format on
   };
@@ -203,8 +344,42 @@ static bool test_all(void) {
   bool result = true;
   for (int i = 0; i < (int)(sizeof(testCases) / sizeof(testCases[0])); ++i) {
     const TestCase *const testCase = &testCases[i];
-    result &= test(testCase->lang, testCase->str, testCase->expected);
+    for (int flags = 0; flags < testAll; ++flags) {
+      result &= test(testCase->lang, flags, testCase->str, testCase->expected);
+    }
+  }
+  return result;
+}
+
+// Sizes below -1 are an empty string for each encoding, not a NUL-terminated string.
+static bool testNegativeSize(void) {
+  static const uint16_t utf16Text[] = {0x79c1, 0x306e, 0x540d, 0x524d, 0};
+  static const uint32_t utf32Text[] = {0x79c1, 0x306e, 0x540d, 0x524d, 0};
+  const char *const utf8Text = u8"私の名前は中野です";
+  bool result = true;
+  for (int encoding = 0; encoding < 3; ++encoding) {
+    for (int bound = 0; bound < 2; ++bound) {
+      hcbudoux_ctx ctx;
+      hcbudoux_span span;
+      int offsets[16];
+      if (encoding == 0 && bound) {
+        hcbudoux_init_lang(&ctx, hcbudoux_lang_ja, utf8Text, -2);
+      } else if (encoding == 0) {
+        hcbudoux_init(&ctx, utf8Text, -2);
+      } else if (encoding == 1 && bound) {
+        hcbudoux_init_lang_utf16(&ctx, hcbudoux_lang_ja, utf16Text, -2);
+      } else if (encoding == 1) {
+        hcbudoux_init_utf16(&ctx, utf16Text, -2);
+      } else if (bound) {
+        hcbudoux_init_lang_utf32(&ctx, hcbudoux_lang_ja, utf32Text, NULL, -2);
+      } else {
+        hcbudoux_init_utf32(&ctx, utf32Text, NULL, -2);
+      }
+      result &= !hcbudoux_getnext(&ctx, &span) && hcbudoux_getbreaks(&ctx, offsets, 16) == 0 &&
+                hcbudoux_find_breaks(hcbudoux_lang_ja, utf8Text, -2, offsets, 16) == 0;
+    }
   }
+  printf("%s: size -2\n", result ? "OK" : "NG");
   return result;
 }
 
@@ -212,5 +387,7 @@ int main(int argc, const char **argv) {
   (void)argc;
   (void)argv;
   init();
-  return test_all() ? EXIT_SUCCESS : EXIT_FAILURE;
+  bool result = test_all();
+  result &= testNegativeSize();
+  return result ? EXIT_SUCCESS : EXIT_FAILURE;
 }
@@ -0,0 +1,3 @@
+// test3 - perfect hash lookup engine
+#define HCBUDOUX_LOOKUP_PERFECT_HASH 1
+#include "./test1.c"
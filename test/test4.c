@@ -0,0 +1,3 @@
+// test4 - unigram page table lookup engine
+#define HCBUDOUX_LOOKUP_UNIGRAM_PAGE_TABLE 1
+#include "./test1.c"
@@ -0,0 +1,3 @@
+// test5 - Eytzinger layout lookup engine
+#define HCBUDOUX_LOOKUP_EYTZINGER 1
+#include "./test1.c"
@@ -0,0 +1,650 @@
+// test6 - block segmentation
+//
+// Compares boundaries of block segmentation (hcbudoux_impl_*_block()) with hcbudoux_impl_getnext() for pseudo text.
+// Also compares hcbudoux_impl_decode_utf8_block() with hcbudoux_impl_decode_utf8() for pseudo bytes, and
+// hcbudoux_getbreaks() (which switches between blocks and spans), hcbudoux_getbreaks_bitmap(), hcbudoux_getscores() and
+// hcbudoux_find_breaks_thresholds() with hcbudoux_getnext().  The stream (hcbudoux_feed()) is compared with the
+// whole buffer for random chunks of pseudo text and pseudo bytes, with hcbudoux_getnext() and each of them.
+#define HCBUDOUX_IMPLEMENTATION 1
+#include <stdbool.h>  // bool, true, false
+#include <stdint.h>   // uint32_t, uint64_t
+#include <stdio.h>    // printf
+#include <stdlib.h>   // EXIT_SUCCESS, EXIT_FAILURE
+#include <string.h>   // memcmp, memcpy, memset, strlen
+
+#include "hcbudoux.h"
+
+enum {
+  textCount = 200,
+  maxTextLength = 400,
+  maxTextSizeInBytes = maxTextLength * 4,
+  maxAsciiRunLength = 64,
+};
+
+typedef uint64_t (*ScoreBlockFunc)(const hcbudoux_impl_block *block);
+
+static uint32_t random32(uint64_t *state) {
+  *state = *state * UINT64_C(6364136223846793005) + UINT64_C(1442695040888963407);
+  return (uint32_t)(*state >> 33);
+}
+
+static int encodeUtf8(uint32_t c, char *p) {
+  if (c < 0x80) {
+    p[0] = (char)c;
+    return 1;
+  } else if (c < 0x800) {
+    p[0] = (char)(0xc0 | (c >> 6));
+    p[1] = (char)(0x80 | (c & 0x3f));
+    return 2;
+  } else if (c < 0x10000) {
+    p[0] = (char)(0xe0 | (c >> 12));
+    p[1] = (char)(0x80 | ((c >> 6) & 0x3f));
+    p[2] = (char)(0x80 | (c & 0x3f));
+    return 3;
+  }
+  p[0] = (char)(0xf0 | (c >> 18));
+  p[1] = (char)(0x80 | ((c >> 12) & 0x3f));
+  p[2] = (char)(0x80 | ((c >> 6) & 0x3f));
+  p[3] = (char)(0x80 | (c & 0x3f));
+  return 4;
+}
+
+// Generate pseudo text from the characters of the model, ASCII, CJK, Thai, emoji and '\0'.  Some texts have runs of
+// ASCII for the ASCII path of the decoder.
+static int generateText(const hcbudoux_impl_tables *tables, uint64_t *state, char *text) {
+  int const length = (int)(random32(state) % maxTextLength);
+  int const asciiPercent = random32(state) % 4 == 0 ? 90 : 10;
+  int size = 0;
+  for (int i = 0; i < length; ++i) {
+    uint32_t c = 0;
+    uint32_t const r = random32(state) % 100;
+    if (r < (uint32_t)asciiPercent) {
+      c = 0x20 + random32(state) % 0x5f;
+    } else if (r < 70) {
+      c = tables->uw.keys[random32(state) % (uint32_t)tables->uw.count];
+    } else if (r < 80) {
+      c = 0x20 + random32(state) % 0x5f;
+    } else if (r < 90) {
+      c = 0x3041 + random32(state) % (0x9fff - 0x3041);
+    } else if (r < 95) {
+      c = 0x0e01 + random32(state) % (0x0e5b - 0x0e01);
+    } else if (r < 99) {
+      c = 0x1f600 + random32(state) % 0x50;
+    }
+    size += encodeUtf8(c, text + size);
+  }
+  return size;
+}
+
+// Returns the number of boundaries (offset of the spans except the first one) of hcbudoux_impl_getnext().
+static int getnextBoundaries(hcbudoux_impl_lang lang, const char *text, int textSize, int *boundaries) {
+  int count = 0;
+  int spanCount = 0;
+  hcbudoux_ctx ctx;
+  hcbudoux_span span;
+  hcbudoux_init(&ctx, text, textSize);
+  while (hcbudoux_impl_getnext(&ctx, &span, lang)) {
+    if (spanCount++ > 0) {
+      boundaries[count++] = span.offset;
+    }
+  }
+  return count;
+}
+
+// Returns the number of boundaries of block segmentation.
+static int blockBoundaries(hcbudoux_impl_lang lang, const char *text, int textSize, ScoreBlockFunc scoreBlock,
+                           int *boundaries) {
+  int count = 0;
+  hcbudoux_impl_block block;
+  hcbudoux_impl_init_block(&block, hcbudoux_impl_get_tables(lang), text, textSize);
+  while (hcbudoux_impl_fill_block(&block)) {
+    uint64_t const bits = scoreBlock(&block);
+    for (int i = 0; i < hcbudoux_impl_block_size; ++i) {
+      if (bits & ((uint64_t)1 << i)) {
+        boundaries[count++] = block.indices[i + 3];
+      }
+    }
+  }
+  return count;
+}
+
+static bool test(const char *name, hcbudoux_impl_lang lang, const char *kernelName, ScoreBlockFunc scoreBlock) {
+  static char text[maxTextSizeInBytes];
+  static int expected[maxTextSizeInBytes];
+  static int actual[maxTextSizeInBytes];
+  const hcbudoux_impl_tables *const tables = hcbudoux_impl_get_tables(lang);
+  uint64_t state = 1;
+  bool result = true;
+  for (int i = 0; i < textCount && result; ++i) {
+    int const textSize = generateText(tables, &state, text);
+    int const expectedCount = getnextBoundaries(lang, text, textSize, expected);
+    int const actualCount = blockBoundaries(lang, text, textSize, scoreBlock, actual);
+    result = expectedCount == actualCount && memcmp(expected, actual, sizeof(expected[0]) * (size_t)actualCount) == 0;
+    if (!result) {
+      printf("text %d: %d boundaries, expected %d boundaries\n", i, actualCount, expectedCount);
+    }
+  }
+  printf("%s: %s, %s\n", result ? "OK" : "NG", name, kernelName);
+  return result;
+}
+
+// Compares hcbudoux_getbreaks() with the ends of the spans of hcbudoux_getnext().  Each call has a random capacity, so
+// it resumes from both the block segmentation and the span by span segmentation.  Also compares the bitmap of
+// hcbudoux_find_breaks_bitmap() and hcbudoux_getbreaks_bitmap() after a few spans of hcbudoux_getnext().
+static bool testGetbreaks(const char *name, hcbudoux_impl_lang lang, const char *kernelName) {
+  static const int capacities[] = {1, 2, hcbudoux_impl_block_size - 1, hcbudoux_impl_block_size,
+                                   hcbudoux_impl_block_size + 1, hcbudoux_impl_block_size * 2 + 3};
+  static char text[maxTextSizeInBytes];
+  static int expected[maxTextSizeInBytes];
+  static int actual[maxTextSizeInBytes];
+  static uint64_t expectedBitmap[maxTextSizeInBytes / 64 + 1];
+  static uint64_t actualBitmap[maxTextSizeInBytes / 64 + 1];
+  const hcbudoux_impl_tables *const tables = hcbudoux_impl_get_tables(lang);
+  uint64_t state = 1;
+  bool result = true;
+  for (int i = 0; i < textCount && result; ++i) {
+    int const textSize = generateText(tables, &state, text);
+    int const words = (textSize + 63) / 64;
+    int expectedCount = 0;
+    int actualCount = 0;
+    hcbudoux_ctx ctx;
+    hcbudoux_span span;
+    hcbudoux_init_lang(&ctx, (hcbudoux_lang)lang, text, textSize);
+    while (hcbudoux_getnext(&ctx, &span)) {
+      expected[expectedCount++] = span.offset + span.length;
+    }
+    hcbudoux_init_lang(&ctx, (hcbudoux_lang)lang, text, textSize);
+    for (int n = 1; n > 0;) {
+      int const capacity = capacities[random32(&state) % (sizeof(capacities) / sizeof(capacities[0]))];
+      n = hcbudoux_getbreaks(&ctx, &actual[actualCount], capacity);
+      actualCount += n;
+    }
+    result = expectedCount == actualCount && memcmp(expected, actual, sizeof(expected[0]) * (size_t)actualCount) == 0;
+    actualCount = hcbudoux_find_breaks((hcbudoux_lang)lang, text, textSize, actual, maxTextSizeInBytes);
+    result &= expectedCount == actualCount && memcmp(expected, actual, sizeof(expected[0]) * (size_t)actualCount) == 0;
+    if (!result) {
+      printf("text %d: %d breaks, expected %d breaks\n", i, actualCount, expectedCount);
+    }
+
+    // The end of the last span is not a break.
+    memset(expectedBitmap, 0, sizeof(expectedBitmap));
+    for (int k = 0; k + 1 < expectedCount; ++k) {
+      expectedBitmap[expected[k] / 64] |= (uint64_t)1 << (expected[k] % 64);
+    }
+    memset(actualBitmap, 0, sizeof(actualBitmap));
+    actualCount = hcbudoux_find_breaks_bitmap((hcbudoux_lang)lang, text, textSize, actualBitmap);
+    result &= actualCount == (expectedCount > 0 ? expectedCount - 1 : 0) &&
+              memcmp(expectedBitmap, actualBitmap, sizeof(actualBitmap[0]) * (size_t)words) == 0;
+    memset(actualBitmap, 0, sizeof(actualBitmap));
+    hcbudoux_init_lang(&ctx, (hcbudoux_lang)lang, text, textSize);
+    for (int k = (int)(random32(&state) % 4); k > 0 && hcbudoux_getnext(&ctx, &span); --k) {
+      if (span.offset > 0) {
+        actualBitmap[span.offset / 64] |= (uint64_t)1 << (span.offset % 64);
+      }
+    }
+    hcbudoux_getbreaks_bitmap(&ctx, actualBitmap);
+    result &= memcmp(expectedBitmap, actualBitmap, sizeof(actualBitmap[0]) * (size_t)words) == 0;
+    if (!result) {
+      printf("text %d: bitmap\n", i);
+    }
+  }
+  printf("%s: %s, %s, getbreaks\n", result ? "OK" : "NG", name, kernelName);
+  return result;
+}
+
+// Converts UTF-8 text to UTF-16 and UTF-32.  utf8Offsets16[i] is the UTF-8 offset of code unit i (both units of a
+// surrogate pair have the offset of the character), and utf8Offsets32[i] is the UTF-8 offset of code point i.  Both
+// have the end of the text after the last character.  Returns the number of code points.
+static int convertText(const char *text, int textSize, uint16_t *utf16, int *utf8Offsets16, int *utf16Length,
+                       uint32_t *utf32, int *utf8Offsets32) {
+  int length = 0;
+  int unitCount = 0;
+  for (int index = 0; index < textSize;) {
+    int size = 0;
+    uint32_t const c = hcbudoux_impl_decode_utf8((const uint8_t *)text, textSize, index, &size);
+    if (c >= 0x10000) {
+      utf16[unitCount] = (uint16_t)(0xd800 + ((c - 0x10000) >> 10));
+      utf8Offsets16[unitCount++] = index;
+      utf16[unitCount] = (uint16_t)(0xdc00 + ((c - 0x10000) & 0x3ff));
+    } else {
+      utf16[unitCount] = (uint16_t)c;
+    }
+    utf8Offsets16[unitCount++] = index;
+    utf32[length] = c;
+    utf8Offsets32[length++] = index;
+    index += size;
+  }
+  utf8Offsets16[unitCount] = textSize;
+  utf8Offsets32[length] = textSize;
+  *utf16Length = unitCount;
+  return length;
+}
+
+// Compares the positive scores of hcbudoux_find_scores() (blocks) with the spans of hcbudoux_getnext(), and
+// hcbudoux_getscores() with small capacities (window of ctx) with hcbudoux_find_scores().  UTF-16 and UTF-32 (with and
+// without offsets) contexts of the same text must have the same scores, and their offsets map to the same UTF-8
+// offsets.  Also compares the bitmaps of hcbudoux_find_breaks_thresholds() (and hcbudoux_getbreaks_thresholds() of each
+// context) with the scores, and the bitmap of threshold 0 with hcbudoux_getbreaks_bitmap() of the same context.
+static bool testGetscores(const char *name, hcbudoux_impl_lang lang, const char *kernelName) {
+  static char text[maxTextSizeInBytes];
+  static int expected[maxTextSizeInBytes];
+  static int scores[maxTextSizeInBytes];
+  static int offsets[maxTextSizeInBytes];
+  static int actualScores[maxTextSizeInBytes];
+  static int actualOffsets[maxTextSizeInBytes];
+  static uint16_t utf16[maxTextLength * 2];
+  static uint32_t utf32[maxTextLength];
+  static int utf8Offsets16[maxTextLength * 2 + 1];
+  static int utf8Offsets32[maxTextLength + 1];
+  static const int thresholds[] = {0, -1000, 1000};
+  enum { thresholdCount = sizeof(thresholds) / sizeof(thresholds[0]), bitmapSize = maxTextSizeInBytes / 64 + 1 };
+  static uint64_t expectedBitmaps[thresholdCount][bitmapSize];
+  static uint64_t actualBitmaps[thresholdCount][bitmapSize];
+  static uint64_t contextBitmaps[thresholdCount][bitmapSize];
+  static uint64_t breaksBitmap[bitmapSize];
+  uint64_t *const bitmaps[thresholdCount] = {actualBitmaps[0], actualBitmaps[1], actualBitmaps[2]};
+  uint64_t *const contextBitmapPointers[thresholdCount] = {contextBitmaps[0], contextBitmaps[1], contextBitmaps[2]};
+  const hcbudoux_impl_tables *const tables = hcbudoux_impl_get_tables(lang);
+  uint64_t state = 1;
+  bool result = true;
+  for (int i = 0; i < textCount && result; ++i) {
+    int const textSize = generateText(tables, &state, text);
+    int const expectedCount = getnextBoundaries(lang, text, textSize, expected);
+    int const count = hcbudoux_find_scores((hcbudoux_lang)lang, text, textSize, scores, offsets, maxTextSizeInBytes);
+    int breakCount = 0;
+    for (int k = 0; k < count; ++k) {
+      if (scores[k] > 0 && offsets[k] > 0 && text[offsets[k]] != 0) {
+        result &= breakCount < expectedCount && expected[breakCount++] == offsets[k];
+      }
+    }
+    result &= breakCount == expectedCount;
+
+    int actualCount = 0;
+    hcbudoux_ctx ctx;
+    hcbudoux_init_lang(&ctx, (hcbudoux_lang)lang, text, textSize);
+    for (int n = 1; n > 0;) {
+      int const capacity = 1 + (int)(random32(&state) % (hcbudoux_impl_block_size * 2));
+      n = hcbudoux_getscores(&ctx, &actualScores[actualCount], &actualOffsets[actualCount], capacity);
+      actualCount += n;
+    }
+    result &= actualCount == count && memcmp(scores, actualScores, sizeof(scores[0]) * (size_t)count) == 0 &&
+              memcmp(offsets, actualOffsets, sizeof(offsets[0]) * (size_t)count) == 0;
+
+    // UTF-16, UTF-32 and UTF-32 with UTF-8 offsets.  Indices of the first two are mapped to UTF-8 offsets.
+    int utf16Length = 0;
+    int const utf32Length = convertText(text, textSize, utf16, utf8Offsets16, &utf16Length, utf32, utf8Offsets32);
+    for (int encoding = 0; encoding < 3; ++encoding) {
+      const int *const utf8OffsetsOf = encoding == 0 ? utf8Offsets16 : encoding == 1 ? utf8Offsets32 : NULL;
+      // Pass 0 : hcbudoux_getbreaks_thresholds(), 1 : hcbudoux_getbreaks_bitmap(), 2 : ctx for hcbudoux_getscores().
+      for (int pass = 0; pass < 3; ++pass) {
+        if (encoding == 0) {
+          hcbudoux_init_lang_utf16(&ctx, (hcbudoux_lang)lang, utf16, utf16Length);
+        } else {
+          hcbudoux_init_lang_utf32(&ctx, (hcbudoux_lang)lang, utf32, encoding == 2 ? utf8Offsets32 : NULL,
+                                   utf32Length);
+        }
+        if (pass == 0) {
+          memset(contextBitmaps, 0, sizeof(contextBitmaps));
+          hcbudoux_getbreaks_thresholds(&ctx, thresholds, thresholdCount, contextBitmapPointers);
+        } else if (pass == 1) {
+          memset(breaksBitmap, 0, sizeof(breaksBitmap));
+          hcbudoux_getbreaks_bitmap(&ctx, breaksBitmap);
+        }
+      }
+      result &= memcmp(contextBitmaps[0], breaksBitmap, sizeof(breaksBitmap)) == 0;
+      actualCount = 0;
+      for (int n = 1; n > 0;) {
+        int const capacity = 1 + (int)(random32(&state) % (hcbudoux_impl_block_size * 2));
+        n = hcbudoux_getscores(&ctx, &actualScores[actualCount], &actualOffsets[actualCount], capacity);
+        actualCount += n;
+      }
+      // The offsets of the context are the bits of its bitmaps.
+      memset(expectedBitmaps, 0, sizeof(expectedBitmaps));
+      for (int k = 0; k < actualCount; ++k) {
+        int const offset = actualOffsets[k];
+        actualOffsets[k] = utf8OffsetsOf ? utf8OffsetsOf[offset] : offset;
+        for (int t = 0; t < thresholdCount; ++t) {
+          if (actualScores[k] > thresholds[t] && actualOffsets[k] > 0 && text[actualOffsets[k]] != 0) {
+            expectedBitmaps[t][offset / 64] |= (uint64_t)1 << (offset % 64);
+          }
+        }
+      }
+      result &= memcmp(expectedBitmaps, contextBitmaps, sizeof(expectedBitmaps)) == 0;
+      result &= actualCount == count && memcmp(scores, actualScores, sizeof(scores[0]) * (size_t)count) == 0 &&
+                memcmp(offsets, actualOffsets, sizeof(offsets[0]) * (size_t)count) == 0;
+    }
+
+    memset(expectedBitmaps, 0, sizeof(expectedBitmaps));
+    memset(actualBitmaps, 0, sizeof(actualBitmaps));
+    for (int k = 0; k < count; ++k) {
+      for (int t = 0; t < thresholdCount; ++t) {
+        if (scores[k] > thresholds[t] && offsets[k] > 0 && text[offsets[k]] != 0) {
+          expectedBitmaps[t][offsets[k] / 64] |= (uint64_t)1 << (offsets[k] % 64);
+        }
+      }
+    }
+    hcbudoux_find_breaks_thresholds((hcbudoux_lang)lang, text, textSize, thresholds, thresholdCount, bitmaps);
+    result &= memcmp(expectedBitmaps, actualBitmaps, sizeof(expectedBitmaps)) == 0;
+    if (!result) {
+      printf("text %d: %d scores, %d breaks, expected %d scores, %d breaks\n", i, actualCount, breakCount, count,
+             expectedCount);
+    }
+  }
+  printf("%s: %s, %s, getscores\n", result ? "OK" : "NG", name, kernelName);
+  return result;
+}
+
+// Generate pseudo bytes: UTF-8 text which has runs of ASCII, 2, 3 and 4 bytes sequences, and broken sequences.
+static int generateBytes(uint64_t *state, uint8_t *bytes) {
+  int const length = (int)(random32(state) % maxTextLength);
+  int size = 0;
+  for (int i = 0; i < length; ++i) {
+    uint32_t const r = random32(state) % 100;
+    if (r < 10) {
+      for (int k = 0, n = (int)(random32(state) % maxAsciiRunLength); k < n; ++k) {
+        bytes[size++] = (uint8_t)(random32(state) % 0x80);
+      }
+    } else if (r < 40) {
+      size += encodeUtf8(random32(state) % 0x80, (char *)&bytes[size]);
+    } else if (r < 50) {
+      size += encodeUtf8(0x80 + random32(state) % 0x780, (char *)&bytes[size]);
+    } else if (r < 90) {
+      size += encodeUtf8(0x800 + random32(state) % 0xf800, (char *)&bytes[size]);
+    } else if (r < 95) {
+      size += encodeUtf8(0x10000 + random32(state) % 0x100000, (char *)&bytes[size]);
+    } else {
+      bytes[size++] = (uint8_t)random32(state);
+    }
+  }
+  return size;
+}
+
+// Compares the spans of the stream of random chunks with the spans of the whole buffer.  Each chunk is copied to a
+// buffer which is overwritten after hcbudoux_getnext() returns false.  hcbudoux_impl_getnext() of another language
+// must return false with offset -1 without changing the stream.
+static bool testStream(const char *name, hcbudoux_impl_lang lang) {
+  static uint8_t bytes[maxTextLength * maxAsciiRunLength];
+  static hcbudoux_span expected[maxTextLength * maxAsciiRunLength];
+  static uint8_t chunk[maxTextLength * maxAsciiRunLength];
+  const hcbudoux_impl_tables *const tables = hcbudoux_impl_get_tables(lang);
+  uint64_t state = 1;
+  bool result = true;
+  for (int i = 0; i < textCount * 2 && result; ++i) {
+    int const size = i % 2 ? generateBytes(&state, bytes) : generateText(tables, &state, (char *)bytes);
+    int expectedCount = 0;
+    hcbudoux_ctx ctx;
+    hcbudoux_span span;
+    hcbudoux_init_lang(&ctx, (hcbudoux_lang)lang, bytes, size);
+    while (hcbudoux_getnext(&ctx, &span)) {
+      expected[expectedCount++] = span;
+    }
+
+    int actualCount = 0;
+    hcbudoux_init_stream(&ctx, (hcbudoux_lang)lang);
+    for (int offset = 0, last = 0; !last;) {
+      int chunkSize = (int)(random32(&state) % (random32(&state) % 4 == 0 ? 100 : 8));
+      if (offset + chunkSize >= size) {
+        chunkSize = size - offset;
+        last = 1;
+      }
+      memcpy(chunk, bytes + offset, (size_t)chunkSize);
+      hcbudoux_feed(&ctx, chunk, chunkSize);
+      offset += chunkSize;
+      if (last) {
+        hcbudoux_finish(&ctx);
+      }
+      if (random32(&state) % 4 == 0) {
+        hcbudoux_impl_lang const otherLang =
+            lang == hcbudoux_impl_lang_th ? hcbudoux_impl_lang_ja : hcbudoux_impl_lang_th;
+        result &= !hcbudoux_impl_getnext(&ctx, &span, otherLang) && span.offset == -1 && span.length == 0;
+      }
+      while (hcbudoux_getnext(&ctx, &span)) {
+        result &= actualCount < expectedCount && span.offset == expected[actualCount].offset &&
+                  span.length == expected[actualCount].length;
+        ++actualCount;
+      }
+      result &= span.offset == 0;  // The end of the chunk, not the misuse
+      memset(chunk, 0xff, (size_t)chunkSize);
+    }
+    result &= actualCount == expectedCount;
+    if (!result) {
+      printf("text %d: %d spans, expected %d spans\n", i, actualCount, expectedCount);
+    }
+  }
+  printf("%s: %s, stream\n", result ? "OK" : "NG", name);
+  return result;
+}
+
+// Compares hcbudoux_getbreaks(), hcbudoux_getbreaks_bitmap(), hcbudoux_getscores() and hcbudoux_getbreaks_thresholds()
+// of the stream of random chunks with the whole buffer.  Each API is called between hcbudoux_feed() calls (with random
+// capacities) and after hcbudoux_finish(), and its results are accumulated.
+static bool testStreamBreaks(const char *name, hcbudoux_impl_lang lang) {
+  enum {
+    maxSize = maxTextLength * maxAsciiRunLength,
+    bitmapSize = maxSize / 64 + 1,
+    thresholdCount = 3,
+  };
+  static const int thresholds[thresholdCount] = {0, -100000, 1000};
+  static const char *const apiNames[] = {"getbreaks", "bitmap", "getscores", "thresholds"};
+  static uint8_t bytes[maxSize];
+  static uint8_t chunk[maxSize];
+  static int expectedOffsets[maxSize];
+  static int actualOffsets[maxSize];
+  static int expectedScores[maxSize];
+  static int actualScores[maxSize];
+  static uint64_t expectedBitmaps[thresholdCount][bitmapSize];
+  static uint64_t actualBitmaps[thresholdCount][bitmapSize];
+  uint64_t *const bitmaps[thresholdCount] = {actualBitmaps[0], actualBitmaps[1], actualBitmaps[2]};
+  const hcbudoux_impl_tables *const tables = hcbudoux_impl_get_tables(lang);
+  uint64_t state = 1;
+  bool result = true;
+  for (int i = 0; i < textCount * 2 && result; ++i) {
+    int const size = i % 2 ? generateBytes(&state, bytes) : generateText(tables, &state, (char *)bytes);
+    for (int api = 0; api < 4 && result; ++api) {
+      int expectedCount = 0;
+      memset(expectedBitmaps, 0, sizeof(expectedBitmaps));
+      if (api == 0) {
+        expectedCount = hcbudoux_find_breaks((hcbudoux_lang)lang, bytes, size, expectedOffsets, maxSize);
+      } else if (api == 1) {
+        expectedCount = hcbudoux_find_breaks_bitmap((hcbudoux_lang)lang, bytes, size, expectedBitmaps[0]);
+      } else if (api == 2) {
+        expectedCount =
+            hcbudoux_find_scores((hcbudoux_lang)lang, bytes, size, expectedScores, expectedOffsets, maxSize);
+      } else {
+        uint64_t *const expected[thresholdCount] = {expectedBitmaps[0], expectedBitmaps[1], expectedBitmaps[2]};
+        hcbudoux_find_breaks_thresholds((hcbudoux_lang)lang, bytes, size, thresholds, thresholdCount, expected);
+      }
+
+      int actualCount = 0;
+      memset(actualBitmaps, 0, sizeof(actualBitmaps));
+      hcbudoux_ctx ctx;
+      hcbudoux_init_stream(&ctx, (hcbudoux_lang)lang);
+      for (int offset = 0, last = 0; !last;) {
+        int chunkSize = (int)(random32(&state) % (random32(&state) % 4 == 0 ? 100 : 8));
+        if (offset + chunkSize >= size) {
+          chunkSize = size - offset;
+          last = 1;
+        }
+        memcpy(chunk, bytes + offset, (size_t)chunkSize);
+        hcbudoux_feed(&ctx, chunk, chunkSize);
+        offset += chunkSize;
+        if (last) {
+          hcbudoux_finish(&ctx);
+        }
+        if (api == 0 || api == 2) {
+          for (int n = 1; n > 0 && actualCount < maxSize;) {
+            int capacity = 1 + (int)(random32(&state) % (hcbudoux_impl_block_size * 2));
+            capacity = capacity < maxSize - actualCount ? capacity : maxSize - actualCount;
+            n = api == 0 ? hcbudoux_getbreaks(&ctx, &actualOffsets[actualCount], capacity)
+                         : hcbudoux_getscores(&ctx, &actualScores[actualCount], &actualOffsets[actualCount], capacity);
+            actualCount += n;
+          }
+        } else if (api == 1) {
+          actualCount += hcbudoux_getbreaks_bitmap(&ctx, actualBitmaps[0]);
+        } else {
+          hcbudoux_getbreaks_thresholds(&ctx, thresholds, thresholdCount, bitmaps);
+        }
+        memset(chunk, 0xff, (size_t)chunkSize);
+      }
+      result &= actualCount == expectedCount && memcmp(expectedBitmaps, actualBitmaps, sizeof(actualBitmaps)) == 0 &&
+                memcmp(expectedOffsets, actualOffsets, sizeof(actualOffsets[0]) * (size_t)actualCount) == 0;
+      if (api == 2) {
+        result &= memcmp(expectedScores, actualScores, sizeof(actualScores[0]) * (size_t)actualCount) == 0;
+      }
+      if (!result) {
+        printf("text %d: %s, %d results, expected %d results\n", i, apiNames[api], actualCount, expectedCount);
+      }
+    }
+  }
+  printf("%s: %s, stream breaks\n", result ? "OK" : "NG", name);
+  return result;
+}
+
+static bool testDecoder(void) {
+  typedef struct {
+    const char *bytes;
+    uint32_t c;
+    int size;
+  } DecoderCase;
+
+  // Ill-formed sequences are U+FFFD of their maximal subpart.
+  static const DecoderCase decoderCases[] = {
+      {"\x7f", 0x7f, 1},           {"\xc2\x80", 0x80, 2},         {"\xe3\x81\x82", 0x3042, 3},
+      {"\xf0\x9f\x98\x80", 0x1f600, 4}, {"\x80", 0xfffd, 1},          {"\xc0\xaf", 0xfffd, 1},
+      {"\xe0\x80\xaf", 0xfffd, 1},   {"\xed\xa0\x80", 0xfffd, 1},    {"\xf4\x90\x80\x80", 0xfffd, 1},
+      {"\xf5\x80", 0xfffd, 1},       {"\xe3\x81", 0xfffd, 2},        {"\xf0\x9f\x98", 0xfffd, 3},
+      {"\xe3\x41", 0xfffd, 1},       {"\xf0\x9f\x41", 0xfffd, 2},    {"\xed\x9f\xbf", 0xd7ff, 3},
+  };
+
+  typedef struct {
+    uint16_t units[2];
+    int length;
+    uint32_t c;
+    int size;
+  } Utf16DecoderCase;
+
+  // Unpaired surrogates are U+FFFD of one code unit.
+  static const Utf16DecoderCase utf16DecoderCases[] = {
+      {{0x3042, 0}, 1, 0x3042, 1},      {{0xd83d, 0xde00}, 2, 0x1f600, 2}, {{0xdbff, 0xdfff}, 2, 0x10ffff, 2},
+      {{0xd83d, 0x3042}, 2, 0xfffd, 1}, {{0xde00, 0xd83d}, 2, 0xfffd, 1},  {{0xd83d, 0xde00}, 1, 0xfffd, 1},
+  };
+
+  // Surrogates and values out of range are U+FFFD.
+  static const uint32_t utf32DecoderCases[][2] = {
+      {0x3042, 0x3042}, {0x1f600, 0x1f600}, {0x10ffff, 0x10ffff},
+      {0xd800, 0xfffd}, {0xdfff, 0xfffd},   {0x110000, 0xfffd},
+  };
+
+  enum { count = 100 };
+  static uint8_t bytes[maxTextLength * maxAsciiRunLength];
+  uint64_t state = 1;
+  bool result = true;
+  for (size_t i = 0; i < sizeof(decoderCases) / sizeof(decoderCases[0]); ++i) {
+    const DecoderCase *const decoderCase = &decoderCases[i];
+    int size = 0;
+    uint32_t const c = hcbudoux_impl_decode_utf8((const uint8_t *)decoderCase->bytes, (int)strlen(decoderCase->bytes),
+                                                 0, &size);
+    if (c != decoderCase->c || size != decoderCase->size) {
+      printf("case %d: U+%04X (%d bytes), expected U+%04X (%d bytes)\n", (int)i, (unsigned)c, size,
+             (unsigned)decoderCase->c, decoderCase->size);
+      result = false;
+    }
+  }
+  for (size_t i = 0; i < sizeof(utf16DecoderCases) / sizeof(utf16DecoderCases[0]); ++i) {
+    const Utf16DecoderCase *const decoderCase = &utf16DecoderCases[i];
+    int size = 0;
+    uint32_t const c = hcbudoux_impl_decode_utf16(decoderCase->units, decoderCase->length, 0, &size);
+    if (c != decoderCase->c || size != decoderCase->size) {
+      printf("UTF-16 case %d: U+%04X (%d units), expected U+%04X (%d units)\n", (int)i, (unsigned)c, size,
+             (unsigned)decoderCase->c, decoderCase->size);
+      result = false;
+    }
+  }
+  for (size_t i = 0; i < sizeof(utf32DecoderCases) / sizeof(utf32DecoderCases[0]); ++i) {
+    int size = 0;
+    uint32_t const c = hcbudoux_impl_decode_utf32(&utf32DecoderCases[i][0], 1, 0, &size);
+    if (c != utf32DecoderCases[i][1] || size != 1) {
+      printf("UTF-32 case %d: U+%04X (%d units), expected U+%04X\n", (int)i, (unsigned)c, size,
+             (unsigned)utf32DecoderCases[i][1]);
+      result = false;
+    }
+  }
+  for (int i = 0; i < textCount * 10 && result; ++i) {
+    int const size = generateBytes(&state, bytes);
+    uint32_t expectedUtf32s[count];
+    int expectedIndices[count];
+    uint32_t actualUtf32s[count];
+    int actualIndices[count];
+    int expectedIndex = (int)(random32(&state) % 4);
+    int actualIndex = expectedIndex;
+    int expectedCount = 0;
+    int actualCount = 0;
+    do {
+      // Decodes up to count characters at a time like hcbudoux_impl_fill_block().
+      expectedCount = 0;
+      while (expectedCount < count) {
+        int charSize = 0;
+        uint32_t const c = hcbudoux_impl_decode_utf8(bytes, size, expectedIndex, &charSize);
+        if (charSize == 0) {
+          break;
+        }
+        expectedUtf32s[expectedCount] = c;
+        expectedIndices[expectedCount++] = expectedIndex;
+        expectedIndex += charSize;
+      }
+      actualCount = hcbudoux_impl_decode_utf8_block(bytes, size, &actualIndex, count, actualUtf32s, actualIndices);
+      result = expectedCount == actualCount && expectedIndex == actualIndex &&
+               memcmp(expectedUtf32s, actualUtf32s, sizeof(expectedUtf32s[0]) * (size_t)actualCount) == 0 &&
+               memcmp(expectedIndices, actualIndices, sizeof(expectedIndices[0]) * (size_t)actualCount) == 0;
+    } while (result && actualCount == count);
+    if (!result) {
+      printf("bytes %d: %d characters at %d, expected %d characters at %d\n", i, actualCount, actualIndex,
+             expectedCount, expectedIndex);
+    }
+  }
+  printf("%s: decoder\n", result ? "OK" : "NG");
+  return result;
+}
+
+int main(int argc, const char **argv) {
+  typedef struct {
+    const char *name;
+    hcbudoux_impl_lang lang;
+  } Language;
+
+  static const Language languages[] = {
+      {"ja", hcbudoux_impl_lang_ja},           {"ja_knbc", hcbudoux_impl_lang_ja_knbc},
+      {"th", hcbudoux_impl_lang_th},           {"zh_hans", hcbudoux_impl_lang_zh_hans},
+      {"zh_hant", hcbudoux_impl_lang_zh_hant},
+  };
+
+  typedef struct {
+    const char *name;
+    hcbudoux_impl_kernel kernel;
+  } Kernel;
+
+  static const Kernel kernels[] = {
+      {"scalar", hcbudoux_impl_kernel_scalar},
+      {"avx2", hcbudoux_impl_kernel_avx2},
+      {"avx512", hcbudoux_impl_kernel_avx512},
+  };
+
+  (void)argc;
+  printf("%s: avx2=%d, dispatch=%d\n", argv[0], HCBUDOUX_IMPL_AVX2, HCBUDOUX_IMPL_DISPATCH);
+
+  bool result = testDecoder();
+  for (size_t i = 0; i < sizeof(languages) / sizeof(languages[0]); ++i) {
+    // Forces each kernel which the host supports.
+    for (size_t k = 0; k < sizeof(kernels) / sizeof(kernels[0]); ++k) {
+      if (hcbudoux_impl_set_kernel(kernels[k].kernel)) {
+        result &= test(languages[i].name, languages[i].lang, kernels[k].name, hcbudoux_impl_score_block);
+        result &= testGetbreaks(languages[i].name, languages[i].lang, kernels[k].name);
+        result &= testGetscores(languages[i].name, languages[i].lang, kernels[k].name);
+      }
+    }
+    hcbudoux_impl_set_kernel(hcbudoux_impl_kernel_auto);
+    result &= testStream(languages[i].name, languages[i].lang);
+    result &= testStreamBreaks(languages[i].name, languages[i].lang);
+  }
+  return result ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,4 @@
+// test7 - block segmentation with AVX2 kernel
+//
+// Makefile builds this file with -mavx2.
+#include "./test6.c"
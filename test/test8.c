@@ -0,0 +1,4 @@
+// test8 - block segmentation and hcbudoux_impl_getnext() with branch and bound
+//
+// Makefile builds this file with -DHCBUDOUX_BRANCH_AND_BOUND=1.
+#include "./test6.c"
@@ -0,0 +1,3 @@
+// test9 - switch lookup engine
+#define HCBUDOUX_LOOKUP_SWITCH 1
+#include "./test1.c"